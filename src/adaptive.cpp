@@ -0,0 +1,4 @@
+#include "adaptive.hpp"
+
+alignas(64) std::atomic<int64_t> _LOAD{0};
+alignas(64) std::atomic<float> _BUDGET{0.5f};
@@ -0,0 +1,147 @@
+#pragma once
+#include "plugin.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+// load adaptive quality shared by Datawave and Chronos                 //
+//                                                                      //
+// each module times a sample of its own process() calls and adds its   //
+// cost to a plugin-wide total. when the total goes over the budget     //
+// every adaptive module steps down a tier, and steps back up once the  //
+// load has stayed low for a while                                      //
+//////////////////////////////////////////////////////////////////////////
+
+// summed cost of every adaptive module, in picoseconds per sample
+extern std::atomic<int64_t> _LOAD;
+
+// share of one engine thread's time the plugin may use before stepping down
+extern std::atomic<float> _BUDGET;
+
+struct AdaptiveQuality
+{
+	static const int TIERS = 3;
+
+	std::atomic<bool> enabled{false}; // set from the UI thread
+	int tier = 0; // 0 full quality, 1 reduced, 2 minimal
+
+	uint32_t frame = 0;
+	uint32_t time_count = 0;
+	float cost = 0.f; // smoothed nanoseconds per sample
+	int64_t published = 0; // what we've added to _LOAD
+	float hold = 0.f; // seconds since the last tier change
+
+	~AdaptiveQuality()
+	{
+		_LOAD -= published;
+	}
+
+	// start timing this call, or 0 if it isn't one of the sampled ones.
+	// 61 is prime so we don't keep landing on the same phase of the dividers below
+	int64_t begin()
+	{
+		if(!enabled.load(std::memory_order_relaxed)) { return 0; }
+		if(++time_count < 61) { return 0; }
+
+		time_count = 0;
+		return system::getNanoseconds();
+	}
+
+	// finish the call, returns true every 4096 samples when the tier has been looked at, so the tier light can follow
+	bool end(int64_t start, float sampleTime)
+	{
+		frame++;
+
+		if(start)
+		{
+			cost += ((system::getNanoseconds() - start) - cost) * 0.05f;
+		}
+
+		if(frame % 4096 != 0) { return false; }
+
+		if(!enabled.load(std::memory_order_relaxed)) // switched off, take ourselves out of the total
+		{
+			_LOAD -= published;
+			published = 0;
+			cost = 0.f;
+			tier = 0;
+			return true;
+		}
+
+		int64_t mine = cost * 1000.f;
+		_LOAD += mine - published;
+		published = mine;
+
+		hold += 4096 * sampleTime;
+
+		double load = _LOAD.load(std::memory_order_relaxed) * 1e-12 / (_BUDGET.load(std::memory_order_relaxed) * sampleTime);
+
+		if(load > 1.0 && tier < TIERS - 1)
+		{
+			tier++;
+			hold = 0.f;
+		}
+
+		// only come back up once things have been quiet for a second, so we don't flip flop
+		else if(load < 0.5 && tier > 0 && hold > 1.f)
+		{
+			tier--;
+			hold = 0.f;
+		}
+
+		return true;
+	}
+
+	// CV inputs and param mirroring are read at control rate in the lower tiers
+	bool control()
+	{
+		static const uint32_t divisions[TIERS] = {1, 4, 16};
+		return frame % divisions[tier] == 0;
+	}
+
+	// how many samples each slew or phase update covers
+	int slewDivision()
+	{
+		static const int divisions[TIERS] = {1, 2, 8};
+		return divisions[tier];
+	}
+
+	int phaseDivision()
+	{
+		static const int divisions[TIERS] = {1, 2, 4};
+		return divisions[tier];
+	}
+
+	// lights are suspended altogether in the lowest tier
+	bool lights()
+	{
+		return tier < 2;
+	}
+
+	// tier light: green for full, yellow for reduced, red for minimal, off when not adaptive
+	void setLight(engine::Light* green_red)
+	{
+		bool on = enabled.load(std::memory_order_relaxed);
+		green_red[0].setBrightness(on && tier < 2 ? 1.f : 0.f);
+		green_red[1].setBrightness(on && tier > 0 ? 1.f : 0.f);
+	}
+
+	// adds the toggle and the shared budget to a module's context menu
+	void appendContextMenu(Menu* menu)
+	{
+		menu->addChild(createBoolMenuItem("Adaptive quality", "",
+			[=]() { return enabled.load(); },
+			[=](bool on) { enabled = on; }
+		));
+
+		static const std::vector<float> budgets = {0.1f, 0.25f, 0.5f, 0.75f};
+		std::vector<std::string> labels;
+		for(float b : budgets) { labels.push_back(string::f("%d%%", (int) std::round(b * 100.f))); }
+
+		menu->addChild(createIndexSubmenuItem("CPU budget (all modules)", labels,
+			[=]() { return (size_t) (std::find(budgets.begin(), budgets.end(), _BUDGET.load()) - budgets.begin()); },
+			[=](size_t i) { _BUDGET = budgets[i]; }
+		));
+
+		static const char* tiers[TIERS] = {"full", "reduced", "minimal"};
+		menu->addChild(createMenuLabel(string::f("Current tier: %s", tiers[tier])));
+	}
+};
@@ -1,13 +1,19 @@
 #include "plugin.hpp"
 #include <dsp/digital.hpp>
+#include "recorder.hpp"
+#include "adaptive.hpp"
 
 ///////////////////////////////////////////////////////////////
 // global variables for syncing with external -=Syn=- module // 
 ///////////////////////////////////////////////////////////////
 
-bool _SYNC = false;
-int _BPM = 120;
-bool _RUN = true;
+// each one sits on its own cache line so readers on other threads don't share a line with anything else
+alignas(64) std::atomic<bool> _SYNC{false};
+alignas(64) std::atomic<int> _BPM{120};
+alignas(64) std::atomic<bool> _RUN{true};
+alignas(64) std::atomic<int> _RAMP{0};
+TempoRamp _RAMPS[2];
+alignas(64) TransportQueue _TRANSPORT;
 
 struct Chronos : Module
 {
@@ -45,6 +51,7 @@ struct Chronos : Module
 	enum LightId
 	{
 		ENUMS(RUN_LIGHT, 3),
+		ENUMS(TIER_LIGHT, 2),
 		LIGHTS_LEN
 	};
 
@@ -53,6 +60,22 @@ struct Chronos : Module
 	bool reset_flag = true;
 
 	rack::dsp::TTimer<double> TIMER; // main timer
+	dsp::ClockDivider lightDivider; // LEDs don't need updating every sample
+
+	RecorderHandle events; // optional log of every lane edge, see recorder.hpp
+	bool lanes[3] = {false, false, false}; // last state of each sub clock, for edge detection
+
+	int ramp_gen = 0; // last tempo ramp seen from -=Syn=-
+	bool ramping = false;
+	TempoRamp ramp;
+	double ramp_origin = 0.0; // beat position the ramp is measured from
+	bool stopped = false; // a ramp keeps going through a stop, so it needs measuring from the restart
+
+	TransportReader transport; // start, stop and reset from -=Syn=-
+	bool transport_run = true;
+	bool reset_pending = false; // lanes are held low for the reset frame
+
+	AdaptiveQuality quality; // steps down under CPU pressure when enabled, see adaptive.hpp
 
 	double freq = 0.f;
 	const float mults[15] = { 1.f / 128.f, 1.f / 64.f, 1.f / 32.f, 1.f / 16.f, 1.f / 8.f, 1.f / 4.f, 1.f / 2.f, 1.f, 2.f, 3.f, 4.f, 6.f, 8.f, 12.f, 16.f };
@@ -81,10 +104,53 @@ struct Chronos : Module
 		configOutput(SUB1_OUTPUT, "sub clock 1");
 		configOutput(SUB2_OUTPUT, "sub clock 2");
 		configOutput(SUB3_OUTPUT, "sub clock 3");
+
+		lightDivider.setDivision(16);
+	}
+
+	// set a sub clock output, logging its edges while recording
+	void setLane(int lane, bool high, int64_t frame)
+	{
+		outputs[SUB1_OUTPUT + lane].setVoltage(high ? 10.f : 0.f);
+
+		if(high != lanes[lane])
+		{
+			lanes[lane] = high;
+			events.push(frame, 'e', lane, high ? 10.f : 0.f);
+		}
 	}
 
 	void process(const ProcessArgs& args) override
 	{
+			int64_t timing = quality.begin();
+
+			/////////////////////////////////////////////////
+			// transport events, all followers act on the //
+			// same sample                                 //
+			/////////////////////////////////////////////////
+
+			if(!transport.joined) { transport_run = _RUN; } // pick up the current state, only changes come through the queue
+
+			transport.process(args.frame, [&](TransportEvent::Kind kind)
+			{
+				events.push(args.frame, 't', kind, 0.f);
+
+				if(kind == TransportEvent::START) { transport_run = true; }
+				else if(kind == TransportEvent::STOP) { transport_run = false; }
+
+				else if(kind == TransportEvent::RESET) // back to the first beat, a ramp carries on from there
+				{
+					TIMER.reset();
+					reset_pending = true;
+
+					if(ramping)
+					{
+						double elapsed = (args.frame - ramp.start_frame) * (double) args.sampleTime;
+						ramp_origin = -ramp.beats(elapsed);
+					}
+				}
+			});
+
 			///////////////////////////
 			// get and set run state //
 			///////////////////////////
@@ -95,7 +161,7 @@ struct Chronos : Module
 
 				if(_SYNC) // if global sync mode is on
 				{
-					run = _RUN; // run clock internally according to run state of external -=Syn=- module
+					run = transport_run; // run clock internally according to run state of external -=Syn=- module
 					tog = run_cv; // toggle output according to run CV
 				}
 
@@ -111,7 +177,7 @@ struct Chronos : Module
 			{
 				if(_SYNC) // if global sync mode is on
 				{
-					run = _RUN; // run clock internally according to run state of external -=Syn=- module
+					run = transport_run; // run clock internally according to run state of external -=Syn=- module
 					tog = params[RUN_PARAM].getValue() > 0.f; // toggle output according to state of run switch
 				}
 
@@ -123,51 +189,57 @@ struct Chronos : Module
 			}
 
 			// toggle run switch LED
-			lights[RUN_LIGHT + 0].setBrightness(tog);
-			lights[RUN_LIGHT + 2].setBrightness(tog);
+			if(quality.lights() && lightDivider.process())
+			{
+				lights[RUN_LIGHT + 0].setBrightness(tog);
+				lights[RUN_LIGHT + 2].setBrightness(tog);
+			}
 
 			////////////////////////////////////////////
 			// get connected CV inputs and set params //
 			////////////////////////////////////////////
 
-			if(inputs[RATE1_CV_INPUT].isConnected())
+			if(quality.control()) // every sample unless adaptive quality has stepped down
 			{
-				int rate1 = std::round(inputs[RATE1_CV_INPUT].getVoltage() / 10.f * 14.f);
-				params[RATE1_PARAM].setValue( clamp(rate1, 0, 14) );
-			}
+				if(inputs[RATE1_CV_INPUT].isConnected())
+				{
+					int rate1 = std::round(inputs[RATE1_CV_INPUT].getVoltage() / 10.f * 14.f);
+					params[RATE1_PARAM].setValue( clamp(rate1, 0, 14) );
+				}
 
-			if(inputs[RATE2_CV_INPUT].isConnected())
-			{
-				int rate2 = std::round(inputs[RATE2_CV_INPUT].getVoltage() / 10.f * 14.f);
-				params[RATE2_PARAM].setValue( clamp(rate2, 0, 14) );
-			}
+				if(inputs[RATE2_CV_INPUT].isConnected())
+				{
+					int rate2 = std::round(inputs[RATE2_CV_INPUT].getVoltage() / 10.f * 14.f);
+					params[RATE2_PARAM].setValue( clamp(rate2, 0, 14) );
+				}
 
 
-			if(inputs[RATE3_CV_INPUT].isConnected())
-			{
-				int rate3 = std::round(inputs[RATE3_CV_INPUT].getVoltage() / 10.f * 14.f);
-				params[RATE3_PARAM].setValue( clamp(rate3, 0, 14) );
-			}
+				if(inputs[RATE3_CV_INPUT].isConnected())
+				{
+					int rate3 = std::round(inputs[RATE3_CV_INPUT].getVoltage() / 10.f * 14.f);
+					params[RATE3_PARAM].setValue( clamp(rate3, 0, 14) );
+				}
 
-			if(inputs[OFF1_CV_INPUT].isConnected())
-			{
-				float off1 = inputs[OFF1_CV_INPUT].getVoltage() / 10.f;
-				off1 = clamp(off1, 0.f, 1.f);
-				params[OFF1_PARAM].setValue( off1 );
-			}
+				if(inputs[OFF1_CV_INPUT].isConnected())
+				{
+					float off1 = inputs[OFF1_CV_INPUT].getVoltage() / 10.f;
+					off1 = clamp(off1, 0.f, 1.f);
+					params[OFF1_PARAM].setValue( off1 );
+				}
 
-			if(inputs[OFF2_CV_INPUT].isConnected())
-			{
-				float off2 = inputs[OFF2_CV_INPUT].getVoltage() / 10.f;
-				off2 = clamp(off2, 0.f, 1.f);
-				params[OFF2_PARAM].setValue( off2 );
-			}
+				if(inputs[OFF2_CV_INPUT].isConnected())
+				{
+					float off2 = inputs[OFF2_CV_INPUT].getVoltage() / 10.f;
+					off2 = clamp(off2, 0.f, 1.f);
+					params[OFF2_PARAM].setValue( off2 );
+				}
 
-			if(inputs[OFF3_CV_INPUT].isConnected())
-			{
-				float off3 = inputs[OFF3_CV_INPUT].getVoltage() / 10.f;
-				off3 = clamp(off3, 0.f, 1.f);
-				params[OFF3_PARAM].setValue( off3 );
+				if(inputs[OFF3_CV_INPUT].isConnected())
+				{
+					float off3 = inputs[OFF3_CV_INPUT].getVoltage() / 10.f;
+					off3 = clamp(off3, 0.f, 1.f);
+					params[OFF3_PARAM].setValue( off3 );
+				}
 			}
 
 			//////////////////////////
@@ -176,25 +248,60 @@ struct Chronos : Module
 
 			if(run)
 			{
+				bool restarting = stopped;
+				stopped = false;
+
 				if(_SYNC) // if global sync mode is on
 				{
 					if(reset_flag) // do once when sync mode is first turned on
 					{
 						TIMER.reset();
-						if(outputs[SUB1_OUTPUT].isConnected()) { outputs[SUB1_OUTPUT].setVoltage(0.f); }
-						if(outputs[SUB2_OUTPUT].isConnected()) { outputs[SUB2_OUTPUT].setVoltage(0.f); }
-						if(outputs[SUB2_OUTPUT].isConnected()) { outputs[SUB2_OUTPUT].setVoltage(0.f); }
+						if(outputs[SUB1_OUTPUT].isConnected()) { setLane(0, false, args.frame); }
+						if(outputs[SUB2_OUTPUT].isConnected()) { setLane(1, false, args.frame); }
+						if(outputs[SUB3_OUTPUT].isConnected()) { setLane(2, false, args.frame); }
 
 						reset_flag = false;
 					}
 
 					freq = _BPM / 60.f; // set main clock freq according to BPM from external -=Syn=- module
 					params[BPM_PARAM].setValue(_BPM); // set BPM knob
+
+					int gen = _RAMP.load(std::memory_order_acquire);
+
+					if(gen != ramp_gen) // a new tempo ramp has started
+					{
+						ramp_gen = gen;
+						ramp = _RAMPS[gen & 1];
+						ramping = true;
+
+						// we may be a frame behind -=Syn=-, so measure from where the ramp began, not from now
+						double elapsed = (args.frame - ramp.start_frame) * (double) args.sampleTime;
+						ramp_origin = TIMER.getTime() - ramp.beats(elapsed);
+					}
+
+					if(ramping) // beat position comes straight from the ramp's integral
+					{
+						double elapsed = (args.frame - ramp.start_frame) * (double) args.sampleTime;
+
+						if(restarting) { ramp_origin = -ramp.beats(elapsed); } // first beat is now, at wherever the ramp has got to
+
+						if(elapsed >= ramp.duration) // done, carry on accumulating at the target tempo from the next sample
+						{
+							freq = ramp.target_bpm / 60.0;
+							ramping = false;
+						}
+
+						// under a beat a sample, so one wrap of the origin keeps it in range without an fmod
+						double time = ramp_origin + ramp.beats(elapsed);
+						if(time >= 128.0) { ramp_origin -= 128.0; time -= 128.0; }
+						TIMER.time = time;
+					}
 				}
 
 				else // when global sync mode is off
 				{
 					reset_flag = true;
+					ramping = false;
 
 					int local_bpm = 120.f;
 
@@ -220,28 +327,37 @@ struct Chronos : Module
 				double _time = TIMER.getTime();
 				if(_time >= 128.f) { TIMER.reset(); } // reset timer to prevent wrap around / overflow, do this when the timer is >= the maximum time div
 
-				if(tog) // if outputs are toggled on, set thier phase and voltage
+				if(reset_pending) // every lane low for the reset frame, so the first beat after it is a fresh rising edge
+				{
+					if(outputs[SUB1_OUTPUT].isConnected()) { setLane(0, false, args.frame); }
+					if(outputs[SUB2_OUTPUT].isConnected()) { setLane(1, false, args.frame); }
+					if(outputs[SUB3_OUTPUT].isConnected()) { setLane(2, false, args.frame); }
+				}
+
+				// lower quality tiers only look at the phases every few samples, the timer itself still runs every sample
+				else if(tog && quality.frame % quality.phaseDivision() == 0) // if outputs are toggled on, set thier phase and voltage
 				{
 					if(outputs[SUB1_OUTPUT].isConnected())
 					{
 						float phase = std::fmod( (_time + params[OFF1_PARAM].getValue() ) * mults[ (int)params[RATE1_PARAM].getValue() ], 1.f);
-						outputs[SUB1_OUTPUT].setVoltage(phase < 0.5f ? 10.f : 0.f);
+						setLane(0, phase < 0.5f, args.frame);
 					}
 
 					if(outputs[SUB2_OUTPUT].isConnected())
 					{
 						float phase = std::fmod( (_time + params[OFF2_PARAM].getValue() ) * mults[ (int)params[RATE2_PARAM].getValue() ], 1.f);
-						outputs[SUB2_OUTPUT].setVoltage(phase < 0.5f ? 10.f : 0.f);
+						setLane(1, phase < 0.5f, args.frame);
 					}
 
 					if(outputs[SUB3_OUTPUT].isConnected())
 					{
 						float phase = std::fmod( (_time + params[OFF3_PARAM].getValue() ) * mults[ (int)params[RATE3_PARAM].getValue() ], 1.f);
-						outputs[SUB3_OUTPUT].setVoltage(phase < 0.5f ? 10.f : 0.f);
+						setLane(2, phase < 0.5f, args.frame);
 					}
 				}
 
-				TIMER.process(freq * args.sampleTime); // accumulate!!!
+				if(!ramping && !reset_pending) { TIMER.process(freq * args.sampleTime); } // accumulate!!! but the first beat starts on the frame after a reset
+				reset_pending = false;
 				}
 
 			///////////////////////////
@@ -251,10 +367,34 @@ struct Chronos : Module
 			else
 			{
 				TIMER.reset();
-				if(outputs[SUB1_OUTPUT].isConnected()) { outputs[SUB1_OUTPUT].setVoltage(0.f); }
-				if(outputs[SUB2_OUTPUT].isConnected()) { outputs[SUB2_OUTPUT].setVoltage(0.f); }
-				if(outputs[SUB2_OUTPUT].isConnected()) { outputs[SUB2_OUTPUT].setVoltage(0.f); }
+				stopped = true;
+				reset_pending = false;
+				if(outputs[SUB1_OUTPUT].isConnected()) { setLane(0, false, args.frame); }
+				if(outputs[SUB2_OUTPUT].isConnected()) { setLane(1, false, args.frame); }
+				if(outputs[SUB3_OUTPUT].isConnected()) { setLane(2, false, args.frame); }
 			}
+
+			if(quality.end(timing, args.sampleTime))
+			{
+				quality.setLight(&lights[TIER_LIGHT]);
+			}
+	}
+
+	json_t* dataToJson() override
+	{
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "adaptive", json_boolean(quality.enabled));
+		json_object_set_new(rootJ, "budget", json_real(_BUDGET));
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override
+	{
+		json_t* adaptiveJ = json_object_get(rootJ, "adaptive");
+		if(adaptiveJ) { quality.enabled = json_boolean_value(adaptiveJ); }
+
+		json_t* budgetJ = json_object_get(rootJ, "budget");
+		if(budgetJ) { _BUDGET = json_number_value(budgetJ); }
 	}
 };
 
@@ -304,6 +444,7 @@ struct ChronosWidget : ModuleWidget
 		addInput(createInputCentered<JACKPort>(mm2px(Vec(horizontal_spacing, vertical_spacing * 1.f + vertical_offset)), module, Chronos::RUN_CV_INPUT));
 		addParam(createParamCentered<TL1105>(mm2px(Vec(horizontal_spacing * 3.f, vertical_spacing * 1.f + vertical_offset)), module, Chronos::RUN_PARAM));
 		addParam(createLightParamCentered<VCVLightLatch<MediumSimpleLight<RedGreenBlueLight>>>(mm2px(Vec(horizontal_spacing * 3.f, vertical_spacing * 1.f + vertical_offset)), module, Chronos::RUN_PARAM, Chronos::RUN_LIGHT));
+		addChild(createLightCentered<TinyLight<GreenRedLight>>(mm2px(Vec(horizontal_spacing * 2.f, vertical_spacing * 1.f + vertical_offset)), module, Chronos::TIER_LIGHT));
 		
 		addInput(createInputCentered<JACKPort>(mm2px(Vec(horizontal_spacing, vertical_spacing * 2.f + vertical_offset)), module, Chronos::BPM_CV_INPUT));
 		addParam(createParamCentered<Pot>(mm2px(Vec(horizontal_spacing * 3.f, vertical_spacing * 2.f + vertical_offset)), module, Chronos::BPM_PARAM));
@@ -326,6 +467,17 @@ struct ChronosWidget : ModuleWidget
 		addInput(createInputCentered<JACKPort>(mm2px(Vec(horizontal_spacing * 3.f, vertical_spacing * 11.5f + vertical_offset)), module, Chronos::OFF3_CV_INPUT));
 		addOutput(createOutputCentered<JACKPort>(mm2px(Vec(horizontal_spacing * 2.f, vertical_spacing * 12.5f + vertical_offset)), module, Chronos::SUB3_OUTPUT));
 	}
+
+	void appendContextMenu(Menu* menu) override
+	{
+		Chronos* module = dynamic_cast<Chronos*>(this->module);
+
+		menu->addChild(new MenuSeparator);
+		module->events.appendContextMenu(menu, string::f("chronos-%lld", (long long) module->id));
+
+		menu->addChild(new MenuSeparator);
+		module->quality.appendContextMenu(menu);
+	}
 };
 
 Model* modelChronos = createModel<Chronos, ChronosWidget>("chronos");
\ No newline at end of file
@@ -1,14 +1,119 @@
 #include "plugin.hpp"
+#include "recorder.hpp"
+#include "datawave_core.hpp"
+#include "adaptive.hpp"
 #include <random>
+#include <osdialog.h>
 
 struct Datawave : Module
 {
 	dsp::SchmittTrigger clockTrigger;
 	dsp::SchmittTrigger reseedTrigger;
 	dsp::SchmittTrigger seedTrigger;
+	dsp::ClockDivider lightDivider; // LEDs don't need updating every sample
 
 	std::default_random_engine generator; // we need to use this pRNG as rand() has a global seed value
 	std::uniform_real_distribution<float> distribution; // we could use other built-in distributions, but we are the cool kids, so we will roll our own! ;)
+	std::mt19937_64 gate_generator; // separate stream for the gates, so they never shift the CV sequence
+
+	uint16_t gates = 0; // one bit per gate channel, set on each clock edge
+
+	/////////////////////////////////////////////////////////////////////
+	// audio rate mode: an internal phase clock replaces the clock input //
+	// and values are drawn and shaped a batch at a time                 //
+	/////////////////////////////////////////////////////////////////////
+
+	static const int BATCH_LEN = 16;
+
+	float batch[BATCH_LEN]; // shaped values between 0 and 1, ready for scale and offset
+	int batch_pos = BATCH_LEN; // start empty, so the first step fills it
+	float phase = 0.f;
+	float step_p = 0.f; // sub-sample position of the last step, for the minBLEP
+	bool stepped = false;
+
+	dsp::MinBlepGenerator<16, 16, float> minBlep; // band limits the steps when not slewing
+
+	/////////////////////////////////////////////////////////////////////
+	// fixed-point mode: same seed, same output on every machine, see  //
+	// datawave_core.hpp. target follows the Q16 values, current is    //
+	// Q32 so slews keep their rate, and the audio rate phase is an    //
+	// integer with no minBLEP                                         //
+	/////////////////////////////////////////////////////////////////////
+
+	DatawaveFixedSequence fixed_generator;
+	int32_t batch_fixed[BATCH_LEN];
+	int32_t fixed_target = 0;
+	int64_t fixed_current = 0; // Q32, see datawaveSlewStep
+	uint32_t fixed_phase = 0; // audio rate phase in 1/2^32ths of a cycle
+	int32_t fixed_pitch = INT32_MIN; // pitch and rate the increment was worked out for
+	int32_t fixed_rate = 0;
+	uint32_t fixed_increment = 0;
+	bool fixed = false;
+
+	RecorderHandle events; // optional log of every step, see recorder.hpp
+	uint32_t step_index = 0; // steps since the last reseed
+
+	//////////////////////////////////////////////////////////////////////
+	// sequence preview: the audio thread publishes a snapshot into one //
+	// of two slots on each step, and the display copies it from there  //
+	//////////////////////////////////////////////////////////////////////
+
+	static const int PREVIEW_LEN = 8; // values shown either side of the current step
+
+	struct PreviewSnapshot
+	{
+		float history[PREVIEW_LEN]; // oldest first, the last one is the current target
+		std::default_random_engine generator; // copy of the generator, so the display can draw ahead on its own
+		DatawaveFixedSequence fixed_generator;
+		bool fixed;
+		unsigned int mode;
+		float scale;
+		float offset;
+		bool ahead; // in audio rate mode the generator is a batch ahead, so there's nothing to preview
+	};
+
+	PreviewSnapshot preview[2];
+	std::atomic<uint32_t> preview_seq{0}; // number of snapshots published
+	std::atomic<uint32_t> preview_writing{0}; // number of the snapshot being written
+	int64_t preview_frame = 0;
+
+	float history[PREVIEW_LEN] = {};
+	int history_pos = 0;
+
+	/////////////////////////////////////////////////////////////////
+	// seeds loaded from a tools/seedsearch result, UI thread only //
+	/////////////////////////////////////////////////////////////////
+
+	struct SeedListEntry
+	{
+		float seed;
+		float score;
+	};
+
+	std::vector<SeedListEntry> seed_list;
+	std::string seed_list_name;
+	int seed_list_skipped = 0; // entries the seed knob can't hold on this machine
+	std::atomic<bool> reseed_request{false};
+	std::atomic<float> pick_seed{-1.f}; // seed picked from the list, -1 when there's none waiting
+
+	/////////////////////////////////////////////////////////////////////
+	// correlated lanes: extra channels on the CV output, each drawn   //
+	// with the main value through the factored correlation matrix     //
+	/////////////////////////////////////////////////////////////////////
+
+	std::mt19937 lane_generator; // separate stream again, so lanes never shift the main sequence
+	std::normal_distribution<float> normal;
+
+	float_4 lane_mix[DATAWAVE_LANES]; // columns of the Cholesky factor
+	float lane_pairs[DATAWAVE_PAIRS]; // the correlations the factor was made from, zero for lanes that are off
+	int lane_count = 0; // lanes the factor was made for
+	std::atomic<float> lane_shrink{1.f}; // how much the correlations had to be pulled in to make a valid matrix
+	float_4 lane_target = 0.f;
+	float_4 lane_current = 0.f;
+
+	TransportReader transport; // reset and reseed from -=Syn=-
+
+	AdaptiveQuality quality; // steps down under CPU pressure when enabled, see adaptive.hpp
 
 	bool seed_flag = false;
 	bool reseed_flag = false;
@@ -42,6 +147,13 @@ struct Datawave : Module
 		TENX_PARAM,
 		MODE_SWITCH,
 		MODE_PARAM,
+		GATES_PARAM,
+		ENUMS(PROB_PARAM, 16),
+		AUDIO_PARAM,
+		FREQ_PARAM,
+		LANES_PARAM,
+		ENUMS(CORR_PARAM, DATAWAVE_PAIRS),
+		FIXED_PARAM,
 		PARAMS_LEN
 	};
 	enum InputId
@@ -60,12 +172,14 @@ struct Datawave : Module
 	enum OutputId
 	{
 		RAND_OUTPUT,
+		GATE_OUTPUT,
 		OUTPUTS_LEN
 	};
 	enum LightId
 	{
 		ENUMS(MODE_LIGHT, 3),
 		ENUMS(TENX_LIGHT, 3),
+		ENUMS(TIER_LIGHT, 2),
 		LIGHTS_LEN
 	};
 
@@ -90,42 +204,361 @@ struct Datawave : Module
 
 		configInput(RESEED_INPUT, "reseed");
 		configInput(GEN_SEED_INPUT, "gen seed");
-		configInput(CLOCK_INPUT, "clock");
+		configInput(CLOCK_INPUT, "clock")->description = "V/oct in audio rate mode";
 		configOutput(RAND_OUTPUT, "CV");
+		configOutput(GATE_OUTPUT, "gates")->description = "one channel per gate, set from the menu";
+
+		// menu only settings, so keep them out of randomize
+		ParamQuantity* gatesQ = configParam(GATES_PARAM, 1, 16, 1, "gate channels");
+		gatesQ->snapEnabled = true;
+		gatesQ->randomizeEnabled = false;
+
+		for(int i = 0; i < 16; i++)
+		{
+			configParam(PROB_PARAM + i, 0.f, 1.f, 0.5f, string::f("gate %d probability", i + 1), "%", 0.f, 100.f)->randomizeEnabled = false;
+		}
+
+		configSwitch(AUDIO_PARAM, 0.f, 1.f, 0.f, "audio rate", {"off", "on"})->randomizeEnabled = false;
+		configParam(FREQ_PARAM, -6.f, 6.f, 0.f, "audio rate frequency", " Hz", 2.f, dsp::FREQ_C4)->randomizeEnabled = false;
+
+		ParamQuantity* lanesQ = configParam(LANES_PARAM, 1, DATAWAVE_LANES, 1, "correlated lanes");
+		lanesQ->snapEnabled = true;
+		lanesQ->randomizeEnabled = false;
+		static const char* pair_names[DATAWAVE_PAIRS] = {"1-2", "1-3", "1-4", "2-3", "2-4", "3-4"};
+		for(int i = 0; i < DATAWAVE_PAIRS; i++)
+		{
+			configParam(CORR_PARAM + i, -1.f, 1.f, 0.f, string::f("lane %s copula correlation", pair_names[i]), "%", 0.f, 100.f)->randomizeEnabled = false;
+		}
+		factorLanes(1);
+
+		configSwitch(FIXED_PARAM, 0.f, 1.f, 0.f, "fixed-point engine", {"off", "on"})->randomizeEnabled = false;
+
+		lightDivider.setDivision(16);
 	}
 
-	void process(const ProcessArgs& args) override
+	void reseedNow(int64_t frame)
 	{
-		/////////////////////////////
-		// set current output mode //
-		/////////////////////////////
+		reseedWith(params[SEED_PARAM].getValue() * seed_cv, frame);
+	}
+
+	void reseedWith(float seed, int64_t frame)
+	{
+		generator.seed(seed);
+		gate_generator.seed(seed);
+		lane_generator.seed(seed);
+		fixed_generator.seed(seed);
+		normal.reset();
+		batch_pos = BATCH_LEN; // throw away values drawn from the old seed
+		step_index = 0;
+		events.push(frame, 'r', 0, seed);
+
+		writePreview(params[AUDIO_PARAM].getValue() > 0.f, frame); // so the upcoming values follow the new seed straight away
+	}
+
+	// audio thread: remember the new target and hand a snapshot to the display
+	void publishPreview(bool audio_rate, int64_t frame)
+	{
+		history[history_pos] = target;
+		history_pos = (history_pos + 1) % PREVIEW_LEN;
+
+		if(audio_rate && frame - preview_frame < 2048) { return; } // no point publishing faster than the display can redraw
+		writePreview(audio_rate, frame);
+	}
+
+	// audio thread: the snapshot itself, without adding to the history
+	void writePreview(bool audio_rate, int64_t frame)
+	{
+		preview_frame = frame;
+
+		uint32_t n = preview_seq.load(std::memory_order_relaxed) + 1;
+		preview_writing.store(n, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		PreviewSnapshot& snap = preview[n & 1];
+
+		for(int i = 0; i < PREVIEW_LEN; i++)
+		{
+			snap.history[i] = history[(history_pos + i) % PREVIEW_LEN];
+		}
+
+		snap.generator = generator;
+		snap.fixed_generator = fixed_generator;
+		snap.fixed = fixed;
+		snap.mode = mode;
+		snap.scale = scale;
+		snap.offset = offset;
+		snap.ahead = audio_rate;
+
+		preview_seq.store(n, std::memory_order_release);
+	}
+
+	// UI thread: copy the latest snapshot, false if the audio thread lapped us while copying
+	bool readPreview(PreviewSnapshot& out, uint32_t& seq)
+	{
+		seq = preview_seq.load(std::memory_order_acquire);
+		out = preview[seq & 1];
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		return preview_writing.load(std::memory_order_relaxed) < seq + 2;
+	}
+
+	////////////////////////////////////////////////////////////////////////
+	// draw four 64-bit words and compare them against every channel at  //
+	// once. the words are sliced into sixteen 16-bit planes, plane k     //
+	// holding bit k of a 16-bit random number for each of the 16         //
+	// channels, and the probabilities are sliced the same way, so a      //
+	// bitwise less-than from the top plane down decides all the channels //
+	// together, to the same 1/65536 the knob can show                    //
+	////////////////////////////////////////////////////////////////////////
+
+	uint16_t sliceGates(int channels)
+	{
+		uint16_t prob_planes[16] = {};
+		uint16_t always = 0;
+
+		for(int c = 0; c < channels; c++)
+		{
+			int threshold = std::round(params[PROB_PARAM + c].getValue() * 65536.f); // probability in 65536ths
+
+			if(threshold >= 65536) { always |= 1 << c; }
+
+			for(int k = 0; k < 16; k++)
+			{
+				if(threshold & (1 << k)) { prob_planes[k] |= 1 << c; }
+			}
+		}
+
+		uint64_t words[4] = {gate_generator(), gate_generator(), gate_generator(), gate_generator()};
+
+		uint16_t less = 0; // channels already known to be below their threshold
+		uint16_t equal = 0xffff; // channels still undecided
+
+		for(int k = 15; k >= 0; k--)
+		{
+			uint16_t rand_plane = words[k / 4] >> (16 * (k % 4));
+			less |= equal & ~rand_plane & prob_planes[k];
+			equal &= ~(rand_plane ^ prob_planes[k]);
+		}
+
+		return (less | always) & ((1 << channels) - 1);
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// draw a whole batch of A/B pairs in the same order the clocked    //
+	// path would, then shape four values at a time for the current mode //
+	//////////////////////////////////////////////////////////////////////
+
+	void fillBatch()
+	{
+		if(fixed)
+		{
+			int32_t A[BATCH_LEN];
+			int32_t B[BATCH_LEN];
+
+			for(int i = 0; i < BATCH_LEN; i++)
+			{
+				A[i] = fixed_generator.uniform();
+				B[i] = fixed_generator.uniform();
+			}
+
+			datawaveShapeFixedBatch(mode, A, B, batch_fixed, BATCH_LEN);
+
+			batch_pos = 0;
+			return;
+		}
+
+		float A[BATCH_LEN];
+		float B[BATCH_LEN];
+
+		for(int i = 0; i < BATCH_LEN; i++)
+		{
+			A[i] = distribution(generator);
+			B[i] = distribution(generator);
+		}
+
+		for(int i = 0; i < BATCH_LEN; i += 4)
+		{
+			shape4(float_4::load(&A[i]), float_4::load(&B[i])).store(&batch[i]);
+		}
+
+		batch_pos = 0;
+	}
+
+	// shape four A/B pairs at once for the current mode
+	float_4 shape4(float_4 a, float_4 b)
+	{
+		if(mode == 0) { return a; } // uniform
+		if(mode == 1) { return simd::fmin(a, b); } // inverse linear
+		if(mode == 2) { return simd::fmax(a, b); } // linear
+		if(mode == 3) { return (a + b) * 0.5f; } // triangle
+
+		float_4 average = (a + b) * 0.5f; // inverse triangle
+		return simd::ifelse(average > 0.5f, average - 0.5f, average + 0.5f);
+	}
+
+	// only redone when a correlation or the lane count has been edited. lanes that are off
+	// are left out, so old settings hidden from the menu can't pull the visible ones in
+	void factorLanes(int lanes)
+	{
+		float L[DATAWAVE_LANES][DATAWAVE_LANES];
+
+		for(int i = 0; i < DATAWAVE_PAIRS; i++)
+		{
+			lane_pairs[i] = DATAWAVE_PAIR_LANE[i] <= lanes ? params[CORR_PARAM + i].getValue() : 0.f;
+		}
+
+		lane_count = lanes;
+		lane_shrink = datawaveLaneFactor(lane_pairs, L);
 
-		if(inputs[MODE_CV_INPUT].isConnected()) // check mode CV input
+		for(int j = 0; j < DATAWAVE_LANES; j++)
 		{
-			params[MODE_PARAM].setValue(inputs[MODE_CV_INPUT].getVoltage() / 2.f);
+			for(int i = 0; i < DATAWAVE_LANES; i++) { lane_mix[j][i] = L[i][j]; }
 		}
+	}
 
-		else
+	// one uniform per lane, lane 1 being the main output's own draw. the first row of
+	// the factor is always 1 0 0 0, so lane 1 comes back out exactly as it went in
+	float_4 mixLanes(float u)
+	{
+		float n0 = datawaveNormalQuantile(clamp(u, 1e-7f, 1.f - 1e-7f));
+		float_4 z = lane_mix[0] * n0;
+
+		for(int j = 1; j < DATAWAVE_LANES; j++)
 		{
-			if(params[MODE_SWITCH].getValue() > 0.f && mode_flag == false) // if mode button pressed
+			z += lane_mix[j] * normal(lane_generator); // always draw all of them, so a lane doesn't change with the lane count
+		}
+
+		float v[DATAWAVE_LANES];
+		z.store(v);
+		for(int i = 0; i < DATAWAVE_LANES; i++) { v[i] = datawaveNormalCdf(v[i]); }
+
+		return float_4::load(v);
+	}
+
+	void drawLanes(float A, float B, int lanes)
+	{
+		bool edited = lanes != lane_count;
+
+		for(int i = 0; i < DATAWAVE_PAIRS && !edited; i++)
+		{
+			edited = DATAWAVE_PAIR_LANE[i] <= lanes && params[CORR_PARAM + i].getValue() != lane_pairs[i];
+		}
+
+		if(edited) { factorLanes(lanes); }
+
+		float_4 a = mixLanes(A);
+		float_4 b = mixLanes(B);
+		lane_target = shape4(a, b) * scale + offset;
+	}
+
+	void drawGates()
+	{
+		gates = sliceGates(clamp((int) params[GATES_PARAM].getValue(), 1, 16));
+	}
+
+	// RAND_MAX is only 32767 on Windows, and seeds past 2^24 don't survive the trip through a float
+	static bool seedFits(double seed)
+	{
+		return seed >= 0.0 && seed <= RAND_MAX && (double) (float) seed == seed;
+	}
+
+	// reads "seed score" lines, skipping blank lines and # comments
+	bool loadSeedList(const std::string& path)
+	{
+		FILE* file = std::fopen(path.c_str(), "r");
+		if(!file) { return false; }
+
+		std::vector<SeedListEntry> list;
+		char line[256];
+		int skipped = 0;
+
+		while(std::fgets(line, sizeof(line), file))
+		{
+			if(line[0] == '#') { continue; }
+
+			double seed;
+			float score = 0.f;
+
+			if(std::sscanf(line, "%lf %f", &seed, &score) >= 1)
 			{
-				params[MODE_PARAM].setValue(params[MODE_PARAM].getValue() + 1); // step to next mode
-				params[MODE_PARAM].setValue( (int)params[MODE_PARAM].getValue() % 5 ); // when last mode reached, wrap around
-				mode_flag = true; // use flag so value is set only once per button press
+				if(seedFits(seed)) { list.push_back({(float) seed, score}); }
+				else { skipped++; }
 			}
+		}
+
+		std::fclose(file);
+
+		if(skipped > 0) { WARN("%s: skipped %d seeds outside 0-%d", path.c_str(), skipped, RAND_MAX); }
+
+		seed_list = list;
+		seed_list_name = system::getFilename(path);
+		seed_list_skipped = skipped;
+		return true;
+	}
 
-			if(params[MODE_SWITCH].getValue() == 0.f) // if mode button is relaeased
+	// UI thread: set the seed knob and reseed on the next sample with the seed exactly as searched, leaving out the seed CV
+	void useSeed(float seed)
+	{
+		params[SEED_PARAM].setValue(seed);
+		pick_seed = seed;
+	}
+
+	json_t* dataToJson() override
+	{
+		json_t* rootJ = json_object();
+		json_t* seedsJ = json_array();
+
+		for(const SeedListEntry& entry : seed_list)
+		{
+			json_t* entryJ = json_array();
+			json_array_append_new(entryJ, json_real(entry.seed));
+			json_array_append_new(entryJ, json_real(entry.score));
+			json_array_append_new(seedsJ, entryJ);
+		}
+
+		json_object_set_new(rootJ, "seedList", seedsJ);
+		json_object_set_new(rootJ, "seedListName", json_string(seed_list_name.c_str()));
+		json_object_set_new(rootJ, "adaptive", json_boolean(quality.enabled));
+		json_object_set_new(rootJ, "budget", json_real(_BUDGET));
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override
+	{
+		seed_list.clear();
+		seed_list_skipped = 0;
+
+		json_t* seedsJ = json_object_get(rootJ, "seedList");
+		size_t i;
+		json_t* entryJ;
+
+		if(seedsJ)
+		{
+			json_array_foreach(seedsJ, i, entryJ)
 			{
-				mode_flag = false; // reset flag
+				double seed = json_number_value(json_array_get(entryJ, 0));
+
+				if(seedFits(seed)) { seed_list.push_back({(float) seed, (float) json_number_value(json_array_get(entryJ, 1))}); }
+				else { seed_list_skipped++; } // saved on a machine with a bigger RAND_MAX
 			}
 		}
 
+		json_t* nameJ = json_object_get(rootJ, "seedListName");
+		if(nameJ) { seed_list_name = json_string_value(nameJ); }
+
+		json_t* adaptiveJ = json_object_get(rootJ, "adaptive");
+		if(adaptiveJ) { quality.enabled = json_boolean_value(adaptiveJ); }
+
+		json_t* budgetJ = json_object_get(rootJ, "budget");
+		if(budgetJ) { _BUDGET = json_number_value(budgetJ); }
+	}
+
+	void updateLights()
+	{
 		//////////////////
 		// set mode LED //
 		//////////////////
 
-		mode = params[MODE_PARAM].getValue(); // set mode variable
-
 		if(mode == 0) // cyan
 		{
 			lights[MODE_LIGHT + 0].setBrightness(0.f);
@@ -144,62 +577,129 @@ struct Datawave : Module
 		{
 			lights[MODE_LIGHT + 0].setBrightness(1.f);
 			lights[MODE_LIGHT + 1].setBrightness(1.f);
-			lights[MODE_LIGHT + 2].setBrightness(0.f);				
+			lights[MODE_LIGHT + 2].setBrightness(0.f);
 		}
 
 		else if(mode == 3) // green
 		{
 			lights[MODE_LIGHT + 0].setBrightness(0.f);
 			lights[MODE_LIGHT + 1].setBrightness(1.f);
-			lights[MODE_LIGHT + 2].setBrightness(0.f);				
+			lights[MODE_LIGHT + 2].setBrightness(0.f);
 		}
 
 		else // white
 		{
 			lights[MODE_LIGHT + 0].setBrightness(1.f);
 			lights[MODE_LIGHT + 1].setBrightness(1.f);
-			lights[MODE_LIGHT + 2].setBrightness(1.f);				
+			lights[MODE_LIGHT + 2].setBrightness(1.f);
 		}
 
 		//////////////////////////////////
 		// set slew rate multiplier LED //
 		//////////////////////////////////
 
-		if(inputs[TENX_CV_INPUT].isConnected())
+		lights[TENX_LIGHT + 1].setBrightness(tenx);
+		lights[TENX_LIGHT + 2].setBrightness(tenx);
+	}
+
+	void process(const ProcessArgs& args) override
+	{
+		int64_t timing = quality.begin();
+		bool control = quality.control(); // every sample unless adaptive quality has stepped down
+
+		///////////////////////////////////////////////////////////
+		// transport events, every follower acts on the same     //
+		// sample. there's no run state here, so start and stop  //
+		// are only logged                                       //
+		///////////////////////////////////////////////////////////
+
+		transport.process(args.frame, [&](TransportEvent::Kind kind)
 		{
-			tenx = inputs[TENX_CV_INPUT].getVoltage() > 0.f;
-			lights[TENX_LIGHT + 1].setBrightness(tenx);
-			lights[TENX_LIGHT + 2].setBrightness(tenx);
+			events.push(args.frame, 't', kind, 0.f);
+
+			if(kind == TransportEvent::RESET) // the sequence starts over from the current seed
+			{
+				reseedNow(args.frame);
+				phase = 0.f;
+				fixed_phase = 0;
+			}
+
+			else if(kind == TransportEvent::RESEED)
+			{
+				reseedNow(args.frame);
+			}
+		});
+
+		/////////////////////////////
+		// set current output mode //
+		/////////////////////////////
+
+		if(control)
+		{
+			if(inputs[MODE_CV_INPUT].isConnected()) // check mode CV input
+			{
+				params[MODE_PARAM].setValue(inputs[MODE_CV_INPUT].getVoltage() / 2.f);
+			}
+
+			else
+			{
+				if(params[MODE_SWITCH].getValue() > 0.f && mode_flag == false) // if mode button pressed
+				{
+					params[MODE_PARAM].setValue(params[MODE_PARAM].getValue() + 1); // step to next mode
+					params[MODE_PARAM].setValue( (int)params[MODE_PARAM].getValue() % 5 ); // when last mode reached, wrap around
+					mode_flag = true; // use flag so value is set only once per button press
+				}
+
+				if(params[MODE_SWITCH].getValue() == 0.f) // if mode button is relaeased
+				{
+					mode_flag = false; // reset flag
+				}
+			}
+
+			mode = params[MODE_PARAM].getValue(); // set mode variable
+
+			if(inputs[TENX_CV_INPUT].isConnected())
+			{
+				tenx = inputs[TENX_CV_INPUT].getVoltage() > 0.f;
+			}
+
+			else
+			{
+				tenx = params[TENX_PARAM].getValue() > 0.f;
+			}
 		}
 
-		else
+		if(quality.lights() && lightDivider.process())
 		{
-			tenx = params[TENX_PARAM].getValue() > 0.f;
-			lights[TENX_LIGHT + 1].setBrightness(tenx);
-			lights[TENX_LIGHT + 2].setBrightness(tenx);
+			updateLights();
 		}
 
-		////////////////////////////////////////////////
-		// only run when the clock input is connected //
-		////////////////////////////////////////////////
+		bool audio_rate = params[AUDIO_PARAM].getValue() > 0.f;
+
+		////////////////////////////////////////////////////////////////
+		// only run when the clock input is connected, or in audio mode //
+		////////////////////////////////////////////////////////////////
 
-		if(inputs[CLOCK_INPUT].isConnected())
+		if(inputs[CLOCK_INPUT].isConnected() || audio_rate)
 		{
 			//////////////////////////////
 			// check and read CV inputs //
 			//////////////////////////////
 
-			if(inputs[SEED_CV_INPUT].isConnected()) { seed_cv = inputs[SEED_CV_INPUT].getVoltage() / 10.f; }
-			else { seed_cv = 1.f; }
+			if(control)
+			{
+				if(inputs[SEED_CV_INPUT].isConnected()) { seed_cv = inputs[SEED_CV_INPUT].getVoltage() / 10.f; }
+				else { seed_cv = 1.f; }
 
-			if(inputs[SCALE_CV_INPUT].isConnected()) { scale_cv = inputs[SCALE_CV_INPUT].getVoltage() / 10.f; }
-			else { scale_cv = 1.f; }
+				if(inputs[SCALE_CV_INPUT].isConnected()) { scale_cv = inputs[SCALE_CV_INPUT].getVoltage() / 10.f; }
+				else { scale_cv = 1.f; }
 
-			if(inputs[OFFSET_CV_INPUT].isConnected()) { offset_cv = inputs[OFFSET_CV_INPUT].getVoltage() / 10.f; }
-			else { offset_cv = 1.f; }
+				if(inputs[OFFSET_CV_INPUT].isConnected()) { offset_cv = inputs[OFFSET_CV_INPUT].getVoltage() / 10.f; }
+				else { offset_cv = 1.f; }
 
-			if(inputs[SLEW_CV_INPUT].isConnected()) { slew_cv = inputs[SLEW_CV_INPUT].getVoltage() / 10.f; }
-			else { slew_cv = 1.f; }		
+				if(inputs[SLEW_CV_INPUT].isConnected()) { slew_cv = inputs[SLEW_CV_INPUT].getVoltage() / 10.f; }
+				else { slew_cv = 1.f; }
+			}
 
 			if(inputs[GEN_SEED_INPUT].isConnected())
 			{
@@ -223,8 +723,7 @@ struct Datawave : Module
 				
 				if(reseed && reseed_flag == false)
 				{
-					float seed = params[SEED_PARAM].getValue() * seed_cv;
-					generator.seed(seed);
+					reseedNow(args.frame);
 					reseed_flag = true;
 				}
 
@@ -234,74 +733,150 @@ struct Datawave : Module
 				}
 			}
 
-			///////////////////////////
-			// check for clock pulse //
-			///////////////////////////
+			if(reseed_request.load(std::memory_order_relaxed) && reseed_request.exchange(false))
+			{
+				reseedNow(args.frame);
+			}
+
+			// picking a seed from the loaded list reseeds straight away
+			if(pick_seed.load(std::memory_order_relaxed) >= 0.f)
+			{
+				float seed = pick_seed.exchange(-1.f);
+				if(seed >= 0.f) { reseedWith(seed, args.frame); }
+			}
 
-			clock = clockTrigger.process(inputs[CLOCK_INPUT].getVoltage(), 0.1f, 2.f);
+			stepped = false;
 
-			/////////////////////////
-			// if clock edge rises //
-			/////////////////////////
+			bool was_fixed = fixed;
+			fixed = params[FIXED_PARAM].getValue() > 0.f;
 
-			if(clock && clock_flag == false)
+			if(fixed != was_fixed) // however it got switched, don't step from a stale batch or slew from a stale value
 			{
-				offset = params[OFFSET_PARAM].getValue() * offset_cv;
-				scale = params[SCALE_PARAM].getValue() * scale_cv;
+				batch_pos = BATCH_LEN;
+				fixed_current = (int64_t) datawaveToFixed(current) << 16;
+				fixed_target = datawaveToFixed(target);
+			}
 
-				float A = distribution(generator);
-				float B = distribution(generator);
+			int lanes = audio_rate || fixed ? 1 : params[LANES_PARAM].getValue(); // correlated lanes only follow the clock, and need floats
 
-				if(mode == 0) // uniform
-				{
-					target = (float) A * scale + offset;
-				}
+			if(audio_rate)
+			{
+				//////////////////////////////////
+				// step on each phase wrap-over //
+				//////////////////////////////////
+
+				float pitch = params[FREQ_PARAM].getValue() + inputs[CLOCK_INPUT].getVoltage(); // the clock jack is free, so it takes V/oct
+				bool wrapped = false;
 
-				else if(mode == 1) // inverse linear
+				if(fixed) // integer phase, so the steps land on the same samples everywhere
 				{
-					if(A < B) { target = (float) A * scale + offset; }
-					else { target = (float) B * scale + offset; }
+					int32_t pitch_fixed = datawaveToFixed(pitch);
+					int32_t rate = std::lround(args.sampleRate);
+
+					if(pitch_fixed != fixed_pitch || rate != fixed_rate) // only redone when the pitch moves, it has a 64 bit divide in it
+					{
+						fixed_pitch = pitch_fixed;
+						fixed_rate = rate;
+						fixed_increment = datawavePhaseIncrement(pitch_fixed, rate);
+					}
+
+					uint32_t last = fixed_phase;
+					fixed_phase += fixed_increment;
+					wrapped = fixed_phase < last;
 				}
-				
-				else if(mode == 2) // linear
+
+				else
 				{
-					if(A > B) { target = (float) A * scale + offset; }
-					else { target = (float) B * scale + offset; }
+					float freq = clamp(dsp::FREQ_C4 * dsp::exp2_taylor5(pitch), 0.f, args.sampleRate / 2.f);
+					float delta = freq * args.sampleTime;
+
+					phase += delta;
+
+					if(phase >= 1.f)
+					{
+						phase -= 1.f;
+						step_p = phase / delta - 1.f;
+						stepped = true;
+						wrapped = true;
+					}
 				}
 
-				else if(mode == 3) // triangle
+				if(wrapped)
 				{
-					float average = (float) ( A + B ) / 2.f;
-					target = (float) average * scale + offset;
+					if(batch_pos >= BATCH_LEN) { fillBatch(); }
+
+					offset = params[OFFSET_PARAM].getValue() * offset_cv;
+					scale = params[SCALE_PARAM].getValue() * scale_cv;
+
+					if(fixed)
+					{
+						fixed_target = datawaveScaleFixed(batch_fixed[batch_pos++], datawaveToFixed(scale), datawaveToFixed(offset));
+						target = datawaveFromFixed(fixed_target);
+					}
+
+					else
+					{
+						target = batch[batch_pos++] * scale + offset;
+					}
+
+					events.push(args.frame, 's', step_index++, target);
+					publishPreview(true, args.frame);
+
+					drawGates(); // even with nothing patched, so the gates stay in step with the CV after a reseed
 				}
 
-				else // inverse triangle
+				clock = fixed ? fixed_phase < 0x80000000u : phase < 0.5f;
+			}
+
+			else
+			{
+				///////////////////////////
+				// check for clock pulse //
+				///////////////////////////
+
+				clock = clockTrigger.process(inputs[CLOCK_INPUT].getVoltage(), 0.1f, 2.f);
+
+				/////////////////////////
+				// if clock edge rises //
+				/////////////////////////
+
+				if(clock && clock_flag == false)
 				{
-					float average = (float) ( A + B ) / 2.f;
+					offset = params[OFFSET_PARAM].getValue() * offset_cv;
+					scale = params[SCALE_PARAM].getValue() * scale_cv;
 
-					if(average > 0.5f)
+					if(fixed)
 					{
-						average = (float) average - 0.5f;
+						fixed_target = fixed_generator.nextFixed(mode, datawaveToFixed(scale), datawaveToFixed(offset));
+						target = datawaveFromFixed(fixed_target);
 					}
 
 					else
 					{
-						average = (float) average + 0.5f;
+						float A = distribution(generator);
+						float B = distribution(generator);
+
+						target = datawaveShape(mode, A, B) * scale + offset;
+
+						if(lanes > 1) { drawLanes(A, B, lanes); }
 					}
 
-					target = (float) average * scale + offset;
+					events.push(args.frame, 's', step_index++, target);
+					publishPreview(false, args.frame);
+
+					drawGates();
+
+					clock_flag = true; // use flag so value is set only once per clock pulse
 				}
-				
-				clock_flag = true; // use flag so value is set only once per clock pulse
-			}
 
-			/////////////////////////
-			// if clock edge falls //
-			/////////////////////////
+				/////////////////////////
+				// if clock edge falls //
+				/////////////////////////
 
-			if(!clock)
-			{
-				clock_flag = false; // reset clock flag
+				if(!clock)
+				{
+					clock_flag = false; // reset clock flag
+				}
 			}
 
 			/////////////////////////////
@@ -312,27 +887,92 @@ struct Datawave : Module
 
 			if(slew < 10.f) // if the slew rate is tiny, don't interpolate
 			{
+				if(stepped) // at audio rate the jump needs band limiting
+				{
+					minBlep.insertDiscontinuity(step_p, clamp(target, 0.f, 10.f) - current);
+				}
+
 				current = target;
+				fixed_current = (int64_t) fixed_target << 16;
+				lane_current = lane_target;
 			}
 
 			else // interpolate!
 			{
 				if(tenx){ slew = slew * 10.f; } // check for slew rate multiplier
 
-				if(current < target) // ramp up to target value
+				int division = quality.slewDivision(); // more than one sample per update when adaptive quality has stepped down
+
+				if(quality.frame % division == 0 && fixed) // integer steps, so the ramp is the same everywhere
 				{
-					current += (1.f/slew);
+					int64_t step = datawaveSlewStep(division, slew);
+					int64_t goal = (int64_t) fixed_target << 16;
+
+					if(fixed_current < goal) { fixed_current = std::min(fixed_current + step, goal); }
+					else { fixed_current = std::max(fixed_current - step, goal); }
+
+					fixed_current = std::min(std::max<int64_t>(fixed_current, 0), 10 * DATAWAVE_ONE_Q32);
+					current = (float) ((double) fixed_current / DATAWAVE_ONE_Q32); // exact in a double, then one rounding to float
 				}
 
-				if(current > target) // ramp down to target value
+				else if(quality.frame % division == 0)
 				{
-					current -= (1.f/slew);
+					float step = division / slew;
+
+					if(current < target) // ramp up to target value
+					{
+						current += step;
+						if(division > 1) { current = std::min(current, target); } // coarse steps would overshoot
+					}
+
+					if(current > target) // ramp down to target value
+					{
+						current -= step;
+						if(division > 1) { current = std::max(current, target); }
+					}
+
+					lane_current += simd::fmax(simd::fmin(lane_target - lane_current, float_4(step)), float_4(-step));
 				}
 			}
 
 			current = clamp(current,0.f,10.f); // clamp values to keep them in range
 
-			outputs[RAND_OUTPUT].setVoltage(current); // set output to current value
+			if(audio_rate && !fixed)
+			{
+				outputs[RAND_OUTPUT].setVoltage(current + minBlep.process()); // add the band limiting residual
+			}
+
+			else
+			{
+				outputs[RAND_OUTPUT].setVoltage(current); // set output to current value
+			}
+
+			outputs[RAND_OUTPUT].setChannels(lanes);
+
+			if(lanes > 1) // lane 1 is the main value, the rest come after it
+			{
+				lane_current = simd::fmax(simd::fmin(lane_current, float_4(10.f)), float_4(0.f));
+				float v[DATAWAVE_LANES];
+				lane_current.store(v);
+				for(int c = 1; c < lanes; c++) { outputs[RAND_OUTPUT].setVoltage(v[c], c); }
+			}
+
+			///////////////////////////////////////////////////////
+			// gates follow the clock, high only on chosen edges //
+			///////////////////////////////////////////////////////
+
+			int gate_channels = clamp((int) params[GATES_PARAM].getValue(), 1, 16);
+			outputs[GATE_OUTPUT].setChannels(gate_channels);
+
+			for(int c = 0; c < gate_channels; c++)
+			{
+				outputs[GATE_OUTPUT].setVoltage(clock && (gates >> c & 1) ? 10.f : 0.f, c);
+			}
+		}
+
+		if(quality.end(timing, args.sampleTime))
+		{
+			quality.setLight(&lights[TIER_LIGHT]);
 		}
 	}
 };
@@ -346,6 +986,109 @@ struct JACKPort : app::SvgPort
     }
 };
 
+////////////////////////////////////////////////////////////////////
+// sequence preview, past values on the left, upcoming on the right //
+////////////////////////////////////////////////////////////////////
+
+struct PreviewDisplay : TransparentWidget
+{
+	Datawave::PreviewSnapshot snapshot;
+	float upcoming[Datawave::PREVIEW_LEN];
+	bool valid = false;
+	float side = 0.f; // width of each half, history on the left and upcoming on the right with the panel's mode icon between
+
+	// run the copied generator forward, the module's own one is never touched
+	void update()
+	{
+		std::uniform_real_distribution<float> distribution;
+
+		for(int i = 0; i < Datawave::PREVIEW_LEN; i++)
+		{
+			if(snapshot.fixed)
+			{
+				upcoming[i] = snapshot.fixed_generator.next(snapshot.mode, snapshot.scale, snapshot.offset);
+				continue;
+			}
+
+			float A = distribution(snapshot.generator);
+			float B = distribution(snapshot.generator);
+			upcoming[i] = datawaveShape(snapshot.mode, A, B) * snapshot.scale + snapshot.offset;
+		}
+
+		valid = true;
+	}
+
+	void drawBar(NVGcontext* vg, float x, int slot, float value, NVGcolor color)
+	{
+		float width = side / Datawave::PREVIEW_LEN;
+		float height = clamp(value, 0.f, 10.f) / 10.f * (box.size.y - 2.f);
+
+		nvgBeginPath(vg);
+		nvgRect(vg, x + slot * width + 0.5f, box.size.y - 1.f - height, width - 1.f, height);
+		nvgFillColor(vg, color);
+		nvgFill(vg);
+	}
+
+	void draw(const DrawArgs& args) override
+	{
+		float right = box.size.x - side;
+
+		nvgBeginPath(args.vg);
+		nvgRoundedRect(args.vg, 0.f, 0.f, side, box.size.y, 1.5f);
+		nvgRoundedRect(args.vg, right, 0.f, side, box.size.y, 1.5f);
+		nvgFillColor(args.vg, nvgRGB(0x10, 0x10, 0x10));
+		nvgFill(args.vg);
+
+		if(!valid) { return; }
+
+		for(int i = 0; i < Datawave::PREVIEW_LEN; i++)
+		{
+			bool current = i == Datawave::PREVIEW_LEN - 1;
+			drawBar(args.vg, 0.f, i, snapshot.history[i], current ? nvgRGB(0xff, 0xff, 0x00) : nvgRGB(0x99, 0x99, 0x00));
+
+			if(!snapshot.ahead)
+			{
+				drawBar(args.vg, right, i, upcoming[i], nvgRGB(0x00, 0x80, 0x80));
+			}
+		}
+	}
+};
+
+// only redraws when the audio thread has published a new step
+struct PreviewFramebuffer : FramebufferWidget
+{
+	Datawave* module = NULL;
+	PreviewDisplay* display;
+	uint32_t seen = 0;
+	float side = 0.f;
+
+	PreviewFramebuffer()
+	{
+		display = new PreviewDisplay;
+		addChild(display);
+	}
+
+	void step() override
+	{
+		display->box.size = box.size;
+		display->side = side;
+
+		if(module && module->preview_seq.load(std::memory_order_acquire) != seen)
+		{
+			uint32_t seq;
+
+			if(module->readPreview(display->snapshot, seq)) // otherwise try again next frame
+			{
+				seen = seq;
+				display->update();
+				setDirty();
+			}
+		}
+
+		FramebufferWidget::step();
+	}
+};
+
 struct DatawaveWidget : ModuleWidget
 {
 	
@@ -386,6 +1129,149 @@ struct DatawaveWidget : ModuleWidget
 
 		addInput(createInputCentered<JACKPort>(mm2px(Vec(horizontal_spacing * 2.f, vertical_spacing * 11.f + vertical_offset)), module, Datawave::CLOCK_INPUT));
 		addOutput(createOutputCentered<JACKPort>(mm2px(Vec(horizontal_spacing * 2.f, vertical_spacing * 12.5f + vertical_offset)), module, Datawave::RAND_OUTPUT));
+		addOutput(createOutputCentered<JACKPort>(mm2px(Vec(4.4f, 98.6f)), module, Datawave::GATE_OUTPUT)); // off the grid, tucked between the 10X CV, the clock and its icon
+
+		addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(horizontal_spacing * 3.f, vertical_spacing * 11.f + vertical_offset)), module, Datawave::TIER_LIGHT));
+
+		PreviewFramebuffer* preview = new PreviewFramebuffer;
+		preview->box.pos = mm2px(Vec(1.5f, vertical_spacing * 3.75f + vertical_offset - 2.f));
+		preview->box.size = mm2px(Vec(17.32f, 4.f));
+		preview->side = mm2px(Vec(6.6f, 0.f)).x; // leaves 8.1mm to 12.2mm clear for the mode icon
+		preview->module = module;
+		addChild(preview);
+	}
+
+	void appendContextMenu(Menu* menu) override
+	{
+		Datawave* module = dynamic_cast<Datawave*>(this->module);
+
+		menu->addChild(new MenuSeparator);
+		module->events.appendContextMenu(menu, string::f("datawave-%lld", (long long) module->id));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("Seed list"));
+
+		menu->addChild(createMenuItem("Load seed list...", "", [=]()
+		{
+			osdialog_filters* filters = osdialog_filters_parse("Seed list (.txt):txt");
+			char* path = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+			osdialog_filters_free(filters);
+
+			if(path)
+			{
+				module->loadSeedList(path);
+				std::free(path);
+			}
+		}));
+
+		if(module->seed_list_skipped > 0)
+		{
+			menu->addChild(createMenuLabel(string::f("%d seeds skipped, the seed knob only goes to %d", module->seed_list_skipped, RAND_MAX)));
+		}
+
+		if(!module->seed_list.empty())
+		{
+			menu->addChild(createSubmenuItem(module->seed_list_name, string::f("%d seeds", (int) module->seed_list.size()), [=](Menu* menu)
+			{
+				for(const Datawave::SeedListEntry& entry : module->seed_list)
+				{
+					float seed = entry.seed;
+					bool current = module->params[Datawave::SEED_PARAM].getValue() == seed;
+
+					menu->addChild(createMenuItem(string::f("%.0f", seed), string::f("%s%.3f", current ? CHECKMARK_STRING " " : "", entry.score), [=]() { module->useSeed(seed); }));
+				}
+			}));
+
+			menu->addChild(createMenuItem("Clear seed list", "", [=]()
+			{
+				module->seed_list.clear();
+				module->seed_list_name = "";
+				module->seed_list_skipped = 0;
+			}));
+		}
+
+		menu->addChild(new MenuSeparator);
+		module->quality.appendContextMenu(menu);
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createBoolMenuItem("Fixed-point engine", "same output on every machine",
+			[=]() { return module->params[Datawave::FIXED_PARAM].getValue() > 0.f; },
+			[=](bool on) { module->params[Datawave::FIXED_PARAM].setValue(on); module->reseed_request = true; }
+		));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("Audio rate"));
+
+		menu->addChild(createBoolMenuItem("Audio rate oscillator", "",
+			[=]() { return module->params[Datawave::AUDIO_PARAM].getValue() > 0.f; },
+			[=](bool on) { module->params[Datawave::AUDIO_PARAM].setValue(on); }
+		));
+
+		ui::Slider* freqSlider = new ui::Slider;
+		freqSlider->quantity = module->paramQuantities[Datawave::FREQ_PARAM];
+		freqSlider->box.size.x = 200.f;
+		menu->addChild(freqSlider);
+		menu->addChild(createMenuLabel("The clock input takes V/oct while this is on"));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("Correlated lanes"));
+
+		menu->addChild(createIndexSubmenuItem("Lanes on CV output", {"1 (off)", "2", "3", "4"},
+			[=]() { return (size_t) module->params[Datawave::LANES_PARAM].getValue() - 1; },
+			[=](size_t i) { module->params[Datawave::LANES_PARAM].setValue(i + 1); }
+		));
+
+		if(module->params[Datawave::FIXED_PARAM].getValue() > 0.f)
+		{
+			menu->addChild(createMenuLabel("Off while the fixed-point engine is on"));
+		}
+
+		menu->addChild(createSubmenuItem("Copula correlations", "", [=](Menu* menu)
+		{
+			int lanes = module->params[Datawave::LANES_PARAM].getValue();
+
+			// set before the mode shaping, which weakens them: about 0.68 from 0.7 in uniform mode, less in the others
+			menu->addChild(createMenuLabel("Set before shaping, the outputs correlate less"));
+
+			for(int i = 0; i < DATAWAVE_PAIRS; i++)
+			{
+				if(DATAWAVE_PAIR_LANE[i] > lanes) { continue; }
+
+				ui::Slider* slider = new ui::Slider;
+				slider->quantity = module->paramQuantities[Datawave::CORR_PARAM + i];
+				slider->box.size.x = 200.f;
+				menu->addChild(slider);
+			}
+
+			if(module->lane_shrink < 1.f)
+			{
+				menu->addChild(createMenuLabel(string::f("Not a valid matrix, scaled to %d%%", (int) std::round(module->lane_shrink * 100.f))));
+			}
+		}));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("Probability gates"));
+
+		std::vector<std::string> channelLabels;
+		for(int i = 1; i <= 16; i++) { channelLabels.push_back(std::to_string(i)); }
+
+		menu->addChild(createIndexSubmenuItem("Channels", channelLabels,
+			[=]() { return (size_t) module->params[Datawave::GATES_PARAM].getValue() - 1; },
+			[=](size_t i) { module->params[Datawave::GATES_PARAM].setValue(i + 1); }
+		));
+
+		menu->addChild(createSubmenuItem("Probabilities", "", [=](Menu* menu)
+		{
+			int channels = module->params[Datawave::GATES_PARAM].getValue();
+
+			for(int i = 0; i < channels; i++)
+			{
+				ui::Slider* slider = new ui::Slider;
+				slider->quantity = module->paramQuantities[Datawave::PROB_PARAM + i];
+				slider->box.size.x = 200.f;
+				menu->addChild(slider);
+			}
+		}));
 	}
 };
 
@@ -0,0 +1,312 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+////////////////////////////////////////////////////////////////////////
+// Datawave's sequence logic with no Rack dependencies, shared by the //
+// module and the offline tools so they always agree on a seed        //
+////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////
+// shape a pair of uniform values into the given mode's     //
+// distribution, giving a value between 0 and 1             //
+//////////////////////////////////////////////////////////////
+
+inline float datawaveShape(unsigned int mode, float A, float B)
+{
+	if(mode == 0) // uniform
+	{
+		return A;
+	}
+
+	else if(mode == 1) // inverse linear
+	{
+		if(A < B) { return A; }
+		else { return B; }
+	}
+
+	else if(mode == 2) // linear
+	{
+		if(A > B) { return A; }
+		else { return B; }
+	}
+
+	else if(mode == 3) // triangle
+	{
+		return (float) ( A + B ) / 2.f;
+	}
+
+	else // inverse triangle
+	{
+		float average = (float) ( A + B ) / 2.f;
+
+		if(average > 0.5f)
+		{
+			return (float) average - 0.5f;
+		}
+
+		else
+		{
+			return (float) average + 0.5f;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// the values a Datawave steps through after a reseed, before the //
+// output clamp and slew                                          //
+////////////////////////////////////////////////////////////////////
+
+struct DatawaveSequence
+{
+	std::default_random_engine generator;
+	std::uniform_real_distribution<float> distribution;
+
+	// the module reseeds from the seed knob times the seed CV, so the seed goes through a float on the way
+	void seed(float seed)
+	{
+		generator.seed(seed);
+	}
+
+	float next(unsigned int mode, float scale, float offset)
+	{
+		float A = distribution(generator);
+		float B = distribution(generator);
+		return datawaveShape(mode, A, B) * scale + offset;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+// fixed-point mode: the standard library leaves default_random_engine  //
+// and uniform_real_distribution up to each implementation, so the      //
+// same seed can give different sequences on different machines.       //
+// this path only uses integer maths and a fully specified generator,   //
+// so it is bit-identical everywhere.                                   //
+//                                                                      //
+// values are Q16: 65536 is 1.0 for shapes and 1V for voltages          //
+//////////////////////////////////////////////////////////////////////////
+
+static const int32_t DATAWAVE_ONE = 1 << 16;
+
+// PCG32 (XSH RR, O'Neill 2014) on stream 54
+struct DatawavePcg32
+{
+	uint64_t state = 0;
+	uint64_t inc = (54u << 1) | 1u;
+
+	void seed(uint64_t seed)
+	{
+		state = 0;
+		next();
+		state += seed;
+		next();
+	}
+
+	uint32_t next()
+	{
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + inc;
+		uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+		uint32_t rot = old >> 59;
+		return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+	}
+};
+
+// same shapes as datawaveShape, on 16 bit values
+inline int32_t datawaveShapeFixed(unsigned int mode, int32_t A, int32_t B)
+{
+	int32_t half = DATAWAVE_ONE / 2;
+	int32_t average = (A + B) >> 1;
+
+	switch(mode)
+	{
+		case 0: return A; // uniform
+		case 1: return A < B ? A : B; // inverse linear
+		case 2: return A > B ? A : B; // linear
+		case 3: return average; // triangle
+		default: return average ^ half; // inverse triangle, adding or taking away a half is just flipping the top bit
+	}
+}
+
+// a whole batch at once. the mode is picked outside the loops, so each one is
+// straight line integer maths the compiler turns into SSE/NEON min, max, add and xor
+inline void datawaveShapeFixedBatch(unsigned int mode, const int32_t* A, const int32_t* B, int32_t* out, int len)
+{
+	const int32_t half = DATAWAVE_ONE / 2;
+
+	switch(mode)
+	{
+		case 0: for(int i = 0; i < len; i++) { out[i] = A[i]; } break;
+		case 1: for(int i = 0; i < len; i++) { out[i] = std::min(A[i], B[i]); } break;
+		case 2: for(int i = 0; i < len; i++) { out[i] = std::max(A[i], B[i]); } break;
+		case 3: for(int i = 0; i < len; i++) { out[i] = (A[i] + B[i]) >> 1; } break;
+		default: for(int i = 0; i < len; i++) { out[i] = ((A[i] + B[i]) >> 1) ^ half; } break;
+	}
+}
+
+// a float setting to Q16, multiplying by a power of two is exact so this rounds the same everywhere
+inline int32_t datawaveToFixed(float value)
+{
+	return (int32_t) std::lround(value * (float) DATAWAVE_ONE);
+}
+
+inline float datawaveFromFixed(int32_t value)
+{
+	return value / (float) DATAWAVE_ONE; // exact for anything within the module's range
+}
+
+// shape times scale plus offset, all Q16. relies on >> of a negative number being arithmetic, as it is on every compiler Rack supports
+inline int32_t datawaveScaleFixed(int32_t shape, int32_t scale, int32_t offset)
+{
+	return (int32_t) (((int64_t) shape * scale) >> 16) + offset;
+}
+
+// slew position is kept in Q32, 1V being 2^32, so a step is at most half a
+// part in 2^32 out and long slews still ramp at the rate the knob says
+static const int64_t DATAWAVE_ONE_Q32 = 1LL << 32;
+
+// volts per slew update in Q32 for a division of samples, integer divide so it rounds the same everywhere
+inline int64_t datawaveSlewStep(int division, float slew)
+{
+	int64_t slew_q16 = std::llround((double) slew * DATAWAVE_ONE); // exact, slew is a float
+	if(slew_q16 <= 0) { return DATAWAVE_ONE_Q32 * 10; }
+	return std::max<int64_t>(1, ((int64_t) division << 48) / slew_q16);
+}
+
+// audio rate phase step for a Q16 pitch in octaves above C4, as a fraction of a cycle
+// in 1/2^32ths. the fractional octave goes through a fifth order Taylor series for
+// 2^x in Q30 (good to 0.15 cents), so there's no libm or float rounding involved
+inline uint32_t datawavePhaseIncrement(int32_t pitch, int32_t sample_rate)
+{
+	static const int64_t C4 = 17145893; // 261.6256 Hz in Q16
+	static const int64_t taylor[5] = {744261118, 257941248, 59597083, 10327387, 1431680}; // ln(2)^n / n! in Q30
+
+	int32_t octave = pitch >> 16;
+	int64_t x = (int64_t) (pitch & 0xffff) << 14; // Q30
+
+	int64_t r = taylor[4];
+	for(int n = 3; n >= 0; n--) { r = taylor[n] + ((r * x) >> 30); }
+	int64_t freq = (C4 * ((1LL << 30) + ((r * x) >> 30))) >> 30; // Q16 Hz
+
+	if(octave >= 0) { freq <<= std::min(octave, 20); }
+	else { freq >>= std::min(-octave, 62); }
+
+	if(sample_rate <= 0) { return 0; }
+	int64_t increment = (freq << 16) / sample_rate;
+	return (uint32_t) std::min<int64_t>(increment, 1LL << 31); // no faster than Nyquist
+}
+
+struct DatawaveFixedSequence
+{
+	DatawavePcg32 generator;
+
+	void seed(float seed)
+	{
+		generator.seed((uint64_t) (int64_t) seed); // truncating a float is exact, so this agrees everywhere too
+	}
+
+	// a uniform value between 0 and 1 in Q16
+	int32_t uniform()
+	{
+		return generator.next() >> 16;
+	}
+
+	int32_t nextFixed(unsigned int mode, int32_t scale, int32_t offset)
+	{
+		int32_t A = uniform();
+		int32_t B = uniform();
+		return datawaveScaleFixed(datawaveShapeFixed(mode, A, B), scale, offset);
+	}
+
+	float next(unsigned int mode, float scale, float offset)
+	{
+		return datawaveFromFixed(nextFixed(mode, datawaveToFixed(scale), datawaveToFixed(offset)));
+	}
+};
+
+////////////////////////////////////////////////////////////////////////
+// correlated lanes: the extra outputs are tied to the main one with  //
+// a gaussian copula, so each lane still gets uniform values to shape //
+////////////////////////////////////////////////////////////////////////
+
+static const int DATAWAVE_LANES = 4;
+static const int DATAWAVE_PAIRS = 6; // 1-2, 1-3, 1-4, 2-3, 2-4, 3-4
+static const int DATAWAVE_PAIR_LANE[DATAWAVE_PAIRS] = {2, 3, 4, 3, 4, 4}; // the higher lane in each pair
+
+// the normal value with the given probability below it (Acklam's approximation, good to about 1e-9)
+inline double datawaveNormalQuantile(double p)
+{
+	static const double a[6] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+	static const double b[5] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01};
+	static const double c[6] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+	static const double d[4] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00};
+
+	if(p < 0.02425) // lower tail
+	{
+		double q = std::sqrt(-2.0 * std::log(p));
+		return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+	}
+
+	if(p > 1.0 - 0.02425) // upper tail
+	{
+		double q = std::sqrt(-2.0 * std::log(1.0 - p));
+		return -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+	}
+
+	double q = p - 0.5;
+	double r = q * q;
+	return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+}
+
+// back from a normal value to a uniform one
+inline float datawaveNormalCdf(float z)
+{
+	return 0.5f * std::erfc(-z * (float) M_SQRT1_2);
+}
+
+// lower triangular L with L * L^T equal to the correlation matrix, false if the matrix isn't valid
+inline bool datawaveCholesky(const float* pairs, float L[DATAWAVE_LANES][DATAWAVE_LANES])
+{
+	static const int pair_index[DATAWAVE_LANES][DATAWAVE_LANES] = {{-1, 0, 1, 2}, {0, -1, 3, 4}, {1, 3, -1, 5}, {2, 4, 5, -1}};
+
+	for(int i = 0; i < DATAWAVE_LANES; i++)
+	{
+		for(int j = 0; j < DATAWAVE_LANES; j++)
+		{
+			if(j > i) { L[i][j] = 0.f; continue; }
+
+			double sum = i == j ? 1.0 : pairs[pair_index[i][j]];
+			for(int k = 0; k < j; k++) { sum -= (double) L[i][k] * L[j][k]; }
+
+			if(i == j)
+			{
+				if(sum <= 1e-6) { return false; }
+				L[i][i] = std::sqrt(sum);
+			}
+
+			else
+			{
+				L[i][j] = sum / L[j][j];
+			}
+		}
+	}
+
+	return true;
+}
+
+// factor the user's matrix, pulling every correlation towards zero until it's valid.
+// returns how much they were scaled by, 1 when the matrix was fine as it was
+inline float datawaveLaneFactor(const float* pairs, float L[DATAWAVE_LANES][DATAWAVE_LANES])
+{
+	float shrink = 1.f;
+	float scaled[DATAWAVE_PAIRS];
+
+	while(true)
+	{
+		for(int i = 0; i < DATAWAVE_PAIRS; i++) { scaled[i] = pairs[i] * shrink; }
+		if(datawaveCholesky(scaled, L)) { return shrink; }
+		shrink *= 0.9f; // all zero is always valid, so this ends
+	}
+}
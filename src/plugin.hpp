@@ -1,5 +1,6 @@
 #pragma once
 #include <rack.hpp>
+#include <atomic>
 
 using namespace rack;
 
@@ -11,6 +12,152 @@ extern Model* modelDatawave;
 extern Model* modelChronos;
 extern Model* modelSyn;
 
-extern bool _SYNC;
-extern int _BPM;
-extern bool _RUN;
\ No newline at end of file
+// Shared with every Chronos in the patch, so they are atomic and only written when they change
+extern std::atomic<bool> _SYNC;
+extern std::atomic<int> _BPM;
+extern std::atomic<bool> _RUN;
+
+///////////////////////////////////////////////////////////////////////////
+// tempo ramp published by -=Syn=-, followers get their beat position    //
+// from the closed form integral of the ramp instead of accumulating it  //
+///////////////////////////////////////////////////////////////////////////
+
+struct TempoRamp
+{
+	int64_t start_frame = 0; // engine frame the ramp started on
+	double start_bpm = 120.0;
+	double target_bpm = 120.0;
+	double duration = 0.0; // seconds
+	bool exponential = false;
+
+	// worked out once by setup(), so following the ramp is one exp or a multiply-add per sample
+	double start_bps = 2.0;
+	double target_bps = 2.0;
+	double rate = 0.0; // exponential, log of the tempo ratio per second
+	double curve = 0.0; // exponential, beats per unit of exp(rate * t) - 1
+	double accel = 0.0; // linear, half the change in beats per second per second
+	double ramp_beats = 0.0; // beats the whole ramp covers
+
+	// sets up a ramp lasting the given number of beats, returns false if it can't be done
+	bool setup(double from, double to, double beats, bool expo)
+	{
+		start_bpm = from;
+		target_bpm = to;
+		exponential = expo && from > 0.0 && to > 0.0 && from != to;
+
+		if(exponential) { duration = 60.0 * beats * std::log(to / from) / (from * (to / from - 1.0)); }
+		else if(from + to > 0.0) { duration = 120.0 * beats / (from + to); }
+		else { return false; }
+
+		start_bps = from / 60.0;
+		target_bps = to / 60.0;
+		rate = exponential ? std::log(to / from) / duration : 0.0;
+		curve = exponential ? start_bps / rate : 0.0;
+		accel = duration > 0.0 ? (target_bps - start_bps) / (2.0 * duration) : 0.0;
+		ramp_beats = beats;
+
+		return true;
+	}
+
+	// tempo t seconds into the ramp
+	double bpm(double t) const
+	{
+		if(t >= duration) { return target_bpm; }
+		if(exponential) { return start_bpm * std::exp(rate * t); }
+		return 60.0 * (start_bps + 2.0 * accel * t);
+	}
+
+	// beats elapsed t seconds into the ramp, carrying on at the target tempo once it's over
+	double beats(double t) const
+	{
+		if(t >= duration) { return ramp_beats + target_bps * (t - duration); }
+		if(exponential) { return curve * (std::exp(rate * t) - 1.0); }
+		return t * (start_bps + accel * t);
+	}
+};
+
+// written by -=Syn=- into the slot after the current one, then published by bumping _RAMP (0 means no ramp yet)
+extern TempoRamp _RAMPS[2];
+extern std::atomic<int> _RAMP;
+///////////////////////////////////////////////////////////////////////////
+// transport events published by -=Syn=-. each one is stamped with the   //
+// frame it takes effect on, the one after it was sent, so every follower //
+// acts on the same sample whatever order the engine runs modules in     //
+///////////////////////////////////////////////////////////////////////////
+
+struct TransportEvent
+{
+	enum Kind : uint8_t
+	{
+		START,
+		STOP,
+		RESET,
+		RESEED
+	};
+
+	int64_t frame;
+	Kind kind;
+};
+
+struct TransportQueue
+{
+	static const uint32_t SIZE = 64; // power of two, followers read every sample so they're never far behind
+
+	TransportEvent events[SIZE];
+	std::atomic<uint32_t> head{0}; // events published so far
+	std::atomic<void*> owner{NULL}; // the one -=Syn=- allowed to publish
+
+	// a -=Syn=- claims the queue before publishing, any others in the patch stay quiet
+	bool claim(void* syn)
+	{
+		void* expected = NULL;
+		return owner.load(std::memory_order_relaxed) == syn || (owner.load(std::memory_order_relaxed) == NULL && owner.compare_exchange_strong(expected, syn));
+	}
+
+	void release(void* syn)
+	{
+		void* expected = syn;
+		owner.compare_exchange_strong(expected, NULL);
+	}
+
+	// only the owner calls this, so there's just the one writer
+	void publish(TransportEvent::Kind kind, int64_t frame)
+	{
+		uint32_t n = head.load(std::memory_order_relaxed);
+		events[n & (SIZE - 1)] = {frame + 1, kind};
+		head.store(n + 1, std::memory_order_release);
+	}
+};
+
+extern TransportQueue _TRANSPORT;
+
+// each follower's own place in the queue
+struct TransportReader
+{
+	uint32_t next = 0;
+	bool joined = false;
+
+	// calls handle(kind) for every event due by this frame
+	template <typename F>
+	void process(int64_t frame, F handle)
+	{
+		uint32_t head = _TRANSPORT.head.load(std::memory_order_acquire);
+
+		if(!joined) // anything already published happened before we were here
+		{
+			next = head;
+			joined = true;
+		}
+
+		if(head - next > TransportQueue::SIZE) { next = head - TransportQueue::SIZE; }
+
+		while(next != head)
+		{
+			const TransportEvent& event = _TRANSPORT.events[next & (TransportQueue::SIZE - 1)];
+			if(event.frame > frame) { break; } // not due yet
+
+			handle(event.kind);
+			next++;
+		}
+	}
+};
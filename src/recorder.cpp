@@ -0,0 +1,127 @@
+#include "recorder.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <thread>
+
+///////////////////////////////////////////////////////////
+// one writer thread for the whole plugin, only running  //
+// while at least one recorder is armed                  //
+///////////////////////////////////////////////////////////
+
+static std::mutex writerMutex;
+static std::condition_variable writerWake;
+static std::vector<Recorder*> writerRecorders;
+static std::thread writerThread;
+static int writerGeneration = 0; // bumped to tell the current writer to exit
+
+static const double FLUSH_INTERVAL = 1.0; // seconds between fflush() calls per log
+
+// call with writerMutex held
+static void drain(Recorder* recorder)
+{
+	while(!recorder->ring.empty())
+	{
+		Recorder::Event e = recorder->ring.shift();
+		if(e.kind == 'r') // a reseed, logged as the whole number the generators are seeded with
+		{
+			fprintf(recorder->file, "%lld,%c,%u,%lld\n", (long long) e.frame, e.kind, e.index, (long long) e.value);
+		}
+
+		else // %.9g round trips any float, so the log holds exactly what was played
+		{
+			fprintf(recorder->file, "%lld,%c,%u,%.9g\n", (long long) e.frame, e.kind, e.index, e.value);
+		}
+	}
+}
+
+static void writerLoop(int generation)
+{
+	std::unique_lock<std::mutex> lock(writerMutex);
+
+	while(writerGeneration == generation)
+	{
+		double now = system::getTime();
+
+		for(Recorder* recorder : writerRecorders)
+		{
+			drain(recorder);
+
+			if(now - recorder->last_flush >= FLUSH_INTERVAL)
+			{
+				fflush(recorder->file);
+				recorder->last_flush = now;
+			}
+		}
+
+		// 20ms is well inside the time it takes to fill a ring, even with an audio rate Datawave
+		writerWake.wait_for(lock, std::chrono::milliseconds(20));
+	}
+}
+
+Recorder::~Recorder()
+{
+	stop();
+}
+
+bool Recorder::start(const std::string& name)
+{
+	std::unique_lock<std::mutex> lock(writerMutex);
+
+	if(file) { return true; }
+
+	std::string dir = asset::user("edgeofchaos");
+	system::createDirectories(dir);
+
+	std::string path = system::join(dir, string::f("%s-%lld.csv", name.c_str(), (long long) std::time(NULL)));
+	file = std::fopen(path.c_str(), "w");
+	if(!file) { return false; }
+
+	fprintf(file, "frame,event,index,value\n");
+	last_flush = system::getTime();
+
+	// anything left from a previous take is stale
+	while(!ring.empty()) { ring.shift(); }
+	dropped = 0;
+
+	writerRecorders.push_back(this);
+
+	if(!writerThread.joinable())
+	{
+		writerThread = std::thread(writerLoop, ++writerGeneration);
+	}
+
+	armed = true;
+	return true;
+}
+
+void Recorder::stop()
+{
+	std::thread finished;
+
+	{
+		std::unique_lock<std::mutex> lock(writerMutex);
+
+		if(!file) { return; }
+
+		armed = false;
+
+		writerRecorders.erase(std::remove(writerRecorders.begin(), writerRecorders.end(), this), writerRecorders.end());
+		drain(this);
+		std::fclose(file);
+		file = NULL;
+
+		// last one out stops the writer
+		if(writerRecorders.empty() && writerThread.joinable())
+		{
+			writerGeneration++;
+			finished = std::move(writerThread);
+		}
+	}
+
+	if(finished.joinable())
+	{
+		writerWake.notify_all();
+		finished.join();
+	}
+}
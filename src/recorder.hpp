@@ -0,0 +1,120 @@
+#pragma once
+#include "plugin.hpp"
+#include <cstdio>
+
+////////////////////////////////////////////////////////////////////////////
+// event recorder shared by Datawave and Chronos                          //
+//                                                                        //
+// the audio thread only ever pushes into a preallocated single-producer  //
+// single-consumer ring, and one background thread for the whole plugin   //
+// drains every armed ring into its own CSV file                          //
+////////////////////////////////////////////////////////////////////////////
+
+struct Recorder
+{
+	struct Event
+	{
+		int64_t frame; // sample timestamp from the engine
+		uint32_t index; // step index for Datawave, lane for Chronos
+		float value; // target voltage for a step, gate voltage for an edge
+		char kind;
+	};
+
+	dsp::RingBuffer<Event, 1 << 13> ring;
+	std::atomic<bool> armed{false};
+	std::atomic<uint64_t> dropped{0};
+
+	// only touched by the UI and writer threads, under the writer's lock
+	FILE* file = NULL;
+	double last_flush = 0.0;
+
+	~Recorder();
+
+	// audio thread: never blocks or allocates, counts the event as dropped when the ring is full
+	void push(int64_t frame, char kind, uint32_t index, float value)
+	{
+		if(!armed.load(std::memory_order_relaxed)) { return; }
+
+		if(ring.full())
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		ring.push({frame, index, value, kind});
+	}
+
+	// UI thread: opens a new log under the user folder and starts recording into it
+	bool start(const std::string& name);
+
+	// UI thread: stops recording, writes out what's left and closes the log
+	void stop();
+
+	bool isRecording()
+	{
+		return armed.load(std::memory_order_relaxed);
+	}
+};
+
+////////////////////////////////////////////////////////////////////////
+// what the modules hold: the recorder is allocated by the UI thread  //
+// the first time recording starts, then kept until the module is     //
+// deleted, so the audio thread never sees it go away                 //
+////////////////////////////////////////////////////////////////////////
+
+struct RecorderHandle
+{
+	std::atomic<Recorder*> recorder{NULL};
+
+	~RecorderHandle()
+	{
+		delete recorder.load();
+	}
+
+	void push(int64_t frame, char kind, uint32_t index, float value)
+	{
+		Recorder* r = recorder.load(std::memory_order_acquire);
+		if(r) { r->push(frame, kind, index, value); }
+	}
+
+	bool isRecording()
+	{
+		Recorder* r = recorder.load(std::memory_order_acquire);
+		return r && r->isRecording();
+	}
+
+	uint64_t getDropped()
+	{
+		Recorder* r = recorder.load(std::memory_order_acquire);
+		return r ? r->dropped.load() : 0;
+	}
+
+	// UI thread only
+	void setRecording(bool on, const std::string& name)
+	{
+		if(on)
+		{
+			if(!recorder.load()) { recorder.store(new Recorder, std::memory_order_release); }
+			recorder.load()->start(name);
+		}
+
+		else if(recorder.load())
+		{
+			recorder.load()->stop();
+		}
+	}
+
+	// adds the record toggle and the dropped count to a module's context menu
+	void appendContextMenu(Menu* menu, const std::string& name)
+	{
+		menu->addChild(createBoolMenuItem("Record events", "",
+			[=]() { return isRecording(); },
+			[=](bool on) { setRecording(on, name); }
+		));
+
+		if(recorder.load())
+		{
+			menu->addChild(createMenuLabel(string::f("Dropped events: %llu", (unsigned long long) getDropped())));
+		}
+	}
+};
@@ -6,12 +6,16 @@ struct Syn : Module
 	{
 		RUN_PARAM,
 		BPM_PARAM,
+		RAMP_TARGET_PARAM,
+		RAMP_BEATS_PARAM,
+		RAMP_CURVE_PARAM,
 		PARAMS_LEN
 	};
 	enum InputId
 	{
 		RUN_CV_INPUT,
 		BPM_CV_INPUT,
+		RAMP_INPUT,
 		INPUTS_LEN
 	};
 	enum OutputId
@@ -28,6 +32,17 @@ struct Syn : Module
 	std::shared_ptr<Font> font;
 	float tempo =120.0f;
 
+	dsp::ClockDivider lightDivider; // LEDs don't need updating every sample
+
+	dsp::SchmittTrigger rampTrigger;
+	std::atomic<bool> ramp_request{false}; // set from the context menu
+	TempoRamp ramp;
+	bool ramping = false;
+
+	int last_run = -1; // run state last sent to the transport queue, -1 before the first one
+	std::atomic<bool> reset_request{false}; // set from the context menu
+	std::atomic<bool> reseed_request{false};
+
 	Syn()
 	{
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -35,21 +50,59 @@ struct Syn : Module
 		configSwitch(RUN_PARAM, 0.f, 1.f, 1.f, "run");
 		configInput(RUN_CV_INPUT, "run CV");
 		configInput(BPM_CV_INPUT, "BPM CV");
+
+		configParam(RAMP_TARGET_PARAM, 0, 999, 120, "ramp target", " BPM")->snapEnabled = true;
+		configParam(RAMP_BEATS_PARAM, 1, 128, 16, "ramp length", " beats")->snapEnabled = true;
+		configSwitch(RAMP_CURVE_PARAM, 0.f, 1.f, 0.f, "ramp curve", {"linear", "exponential"});
+		configInput(RAMP_INPUT, "start tempo ramp");
+
+		lightDivider.setDivision(16);
 	}
 
 	void process(const ProcessArgs& args) override
 	{
-		_SYNC = true;
+		// the globals are read by every Chronos in the patch, so only write them when they change
+		if(!_SYNC) { _SYNC = true; }
+
+
+		////////////////////////////////////////////////////
+		// start a tempo ramp from the menu or trigger    //
+		////////////////////////////////////////////////////
+
+		bool start_ramp = ramp_request.load(std::memory_order_relaxed) && ramp_request.exchange(false);
+		if(inputs[RAMP_INPUT].isConnected() && rampTrigger.process(inputs[RAMP_INPUT].getVoltage(), 0.1f, 2.f)) { start_ramp = true; }
+
+		if(start_ramp)
+		{
+			// fill the slot the followers aren't reading, then publish it
+			int gen = _RAMP.load(std::memory_order_relaxed) + 1;
+			TempoRamp& next = _RAMPS[gen & 1];
 
+			if(next.setup(params[BPM_PARAM].getValue(), params[RAMP_TARGET_PARAM].getValue(), params[RAMP_BEATS_PARAM].getValue(), params[RAMP_CURVE_PARAM].getValue() > 0.f))
+			{
+				next.start_frame = args.frame;
+				ramp = next;
+				ramping = true;
+				_RAMP.store(gen, std::memory_order_release);
+			}
+		}
 
-		if(inputs[BPM_CV_INPUT].isConnected())
+		if(ramping) // the ramp owns the tempo until it's done, so BPM CV is ignored
+		{
+			double t = (args.frame - ramp.start_frame) * (double) args.sampleTime;
+			if(t >= ramp.duration) { ramping = false; }
+			params[BPM_PARAM].setValue(ramp.bpm(t));
+		}
+
+		else if(inputs[BPM_CV_INPUT].isConnected())
 		{
 			float cv = clamp(inputs[BPM_CV_INPUT].getVoltage() / 10.f, 0.f, 1.f);
 			params[BPM_PARAM].setValue( std::round( cv * 999.f ) );
 		}
 
-		_BPM = std::round(params[BPM_PARAM].getValue());
-		tempo = _BPM;
+		int bpm = std::round(params[BPM_PARAM].getValue());
+		if(_BPM != bpm) { _BPM = bpm; }
+		tempo = bpm;
 
 		/////////////////////////////////////////////
 		// get toggle switch state and set run LED //
@@ -65,13 +118,49 @@ struct Syn : Module
 			tog = params[RUN_PARAM].getValue() > 0.f;
 		}
 
-		lights[RUN_LIGHT + 0].setBrightness(tog);
-		lights[RUN_LIGHT + 1].setBrightness(tog);
-		_RUN = tog;
+		if(lightDivider.process())
+		{
+			lights[RUN_LIGHT + 0].setBrightness(tog);
+			lights[RUN_LIGHT + 1].setBrightness(tog);
+		}
+
+		if(_RUN != tog) { _RUN = tog; }
+
+		/////////////////////////////////////////////////////////
+		// transport events for every Chronos and Datawave,    //
+		// they all act on the next sample. only one -=Syn=-   //
+		// in the patch gets to send them                      //
+		/////////////////////////////////////////////////////////
+
+		bool reset = reset_request.load(std::memory_order_relaxed) && reset_request.exchange(false);
+		bool reseed = reseed_request.load(std::memory_order_relaxed) && reseed_request.exchange(false);
+
+		if(_TRANSPORT.claim(this))
+		{
+			if(tog != last_run)
+			{
+				_TRANSPORT.publish(tog ? TransportEvent::START : TransportEvent::STOP, args.frame);
+				last_run = tog;
+			}
+
+			if(reset) { _TRANSPORT.publish(TransportEvent::RESET, args.frame); }
+			if(reseed) { _TRANSPORT.publish(TransportEvent::RESEED, args.frame); }
+		}
+
+		else
+		{
+			last_run = -1; // send our state straight away if we ever take over
+		}
+	}
+
+	~Syn()
+	{
+		_TRANSPORT.release(this);
 	}
 
 	void onRemove() override
 	{
+		_TRANSPORT.release(this);
         _SYNC = false;
     }
 };
@@ -164,6 +253,35 @@ struct SynWidget : ModuleWidget
 		addInput(createInputCentered<JACKPort>(mm2px(Vec(horizontal_spacing * 2.f, vertical_spacing * 3.f + vertical_offset)), module, Syn::RUN_CV_INPUT));
 		addInput(createInputCentered<JACKPort>(mm2px(Vec(horizontal_spacing * 2.f, vertical_spacing * 8.75f + vertical_offset)), module, Syn::BPM_CV_INPUT));
 		addParam(createParamCentered<BigPot>(mm2px(Vec(horizontal_spacing * 2.f, vertical_spacing * 10.5f + vertical_offset)), module, Syn::BPM_PARAM));
+		addInput(createInputCentered<JACKPort>(mm2px(Vec(horizontal_spacing * 2.f, vertical_spacing * 7.f + vertical_offset)), module, Syn::RAMP_INPUT));
+	}
+
+	void appendContextMenu(Menu* menu) override
+	{
+		Syn* module = dynamic_cast<Syn*>(this->module);
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("Tempo ramp"));
+
+		for(int id : {Syn::RAMP_TARGET_PARAM, Syn::RAMP_BEATS_PARAM})
+		{
+			ui::Slider* slider = new ui::Slider;
+			slider->quantity = module->paramQuantities[id];
+			slider->box.size.x = 200.f;
+			menu->addChild(slider);
+		}
+
+		menu->addChild(createIndexSubmenuItem("Curve", {"Linear", "Exponential"},
+			[=]() { return (size_t) module->params[Syn::RAMP_CURVE_PARAM].getValue(); },
+			[=](size_t i) { module->params[Syn::RAMP_CURVE_PARAM].setValue(i); }
+		));
+
+		menu->addChild(createMenuItem("Start ramp", "", [=]() { module->ramp_request = true; }));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("Transport"));
+		menu->addChild(createMenuItem("Reset clocks and sequences", "", [=]() { module->reset_request = true; }));
+		menu->addChild(createMenuItem("Reseed Datawaves", "", [=]() { module->reseed_request = true; }));
 	}
 };
 
@@ -0,0 +1,342 @@
+////////////////////////////////////////////////////////////////////////////
+// Offline Datawave seed search                                           //
+//                                                                        //
+// Runs the same sequence logic as the module (src/datawave_core.hpp)     //
+// for every seed in a range, on every core, scores each seed's first N   //
+// steps against the chosen criteria and writes out the top K. Load the   //
+// result into a Datawave with "Load seed list..." in its context menu.   //
+//                                                                        //
+// Build with `make seedsearch`, run with `build/seedsearch -h`.          //
+////////////////////////////////////////////////////////////////////////////
+
+#include "../src/datawave_core.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int MAX_STEPS = 256;
+
+struct Options
+{
+	// the module settings the sequence is played with
+	unsigned int mode = 0;
+	float scale = 10.f;
+	float offset = 0.f;
+	int steps = 16;
+	bool fixed = false; // the module's fixed-point engine
+
+	// search range, every seed below 2^24 survives the trip through a float
+	long long from = 0;
+	long long to = 1 << 24;
+	int top = 32;
+	int threads = std::thread::hardware_concurrency();
+	std::string out = "seeds.txt";
+
+	// criteria weights, zero means not used
+	float coverage = 0.f;
+	float repetition = 0.f;
+	float repetition_target = 0.f; // wanted fraction of repeated notes
+	float contour = 0.f;
+	std::string contour_shape = "up";
+	float contour_ref[MAX_STEPS]; // the shape itself, filled in once before the search
+	float interval = 0.f;
+	float interval_target = 1.f; // wanted mean step size in volts
+	float fit = 0.f;
+	int scale_mask = 0xab5; // major
+};
+
+////////////////////////////////////////////////////////////////
+// criteria, each scored between 0 (worst) and 1 (best)       //
+////////////////////////////////////////////////////////////////
+
+// how many of 10 equal bands across the 0-10V output the sequence visits
+static float scoreCoverage(const float* v, int n)
+{
+	int bands = 0;
+
+	for(int i = 0; i < n; i++)
+	{
+		bands |= 1 << std::min(9, (int) (v[i]));
+	}
+
+	int hit = 0;
+	for(int b = 0; b < 10; b++) { hit += bands >> b & 1; }
+
+	return hit / 10.f;
+}
+
+// closeness of the fraction of steps that repeat an earlier note (to the semitone) to the target fraction
+static float scoreRepetition(const float* v, int n, float target)
+{
+	int repeats = 0;
+
+	for(int i = 1; i < n; i++)
+	{
+		int note = std::round(v[i] * 12.f);
+
+		for(int j = 0; j < i; j++)
+		{
+			if(std::round(v[j] * 12.f) == note) { repeats++; break; }
+		}
+	}
+
+	float fraction = n > 1 ? repeats / (float) (n - 1) : 0.f;
+	return 1.f - std::fabs(fraction - target);
+}
+
+static void buildContour(Options& o)
+{
+	for(int i = 0; i < o.steps; i++)
+	{
+		float x = i / (float) (o.steps - 1);
+
+		if(o.contour_shape == "down") { o.contour_ref[i] = 1.f - x; }
+		else if(o.contour_shape == "arch") { o.contour_ref[i] = 1.f - std::fabs(2.f * x - 1.f); }
+		else if(o.contour_shape == "valley") { o.contour_ref[i] = std::fabs(2.f * x - 1.f); }
+		else { o.contour_ref[i] = x; }
+	}
+}
+
+// correlation with the chosen contour, mapped from -1..1 to 0..1
+static float scoreContour(const float* v, int n, const float* ref)
+{
+	float mean_v = 0.f, mean_r = 0.f;
+	for(int i = 0; i < n; i++) { mean_v += v[i]; mean_r += ref[i]; }
+	mean_v /= n;
+	mean_r /= n;
+
+	float cov = 0.f, var_v = 0.f, var_r = 0.f;
+
+	for(int i = 0; i < n; i++)
+	{
+		cov += (v[i] - mean_v) * (ref[i] - mean_r);
+		var_v += (v[i] - mean_v) * (v[i] - mean_v);
+		var_r += (ref[i] - mean_r) * (ref[i] - mean_r);
+	}
+
+	if(var_v <= 0.f || var_r <= 0.f) { return 0.5f; }
+	return 0.5f + 0.5f * cov / std::sqrt(var_v * var_r);
+}
+
+// closeness of the mean step size to the target, in volts
+static float scoreInterval(const float* v, int n, float target)
+{
+	float total = 0.f;
+	for(int i = 1; i < n; i++) { total += std::fabs(v[i] - v[i - 1]); }
+
+	float mean = n > 1 ? total / (n - 1) : 0.f;
+	return 1.f / (1.f + std::fabs(mean - target));
+}
+
+// fraction of steps within 10 cents of a note in the scale, read as 1V/oct from 0V = C
+static float scoreFit(const float* v, int n, int mask)
+{
+	int in = 0;
+
+	for(int i = 0; i < n; i++)
+	{
+		float semis = v[i] * 12.f;
+		int note = std::round(semis);
+
+		if(std::fabs(semis - note) <= 0.1f && (mask >> (note % 12) & 1)) { in++; }
+	}
+
+	return in / (float) n;
+}
+
+static float score(const Options& o, const float* v)
+{
+	float total = 0.f;
+
+	if(o.coverage > 0.f) { total += o.coverage * scoreCoverage(v, o.steps); }
+	if(o.repetition > 0.f) { total += o.repetition * scoreRepetition(v, o.steps, o.repetition_target); }
+	if(o.contour > 0.f) { total += o.contour * scoreContour(v, o.steps, o.contour_ref); }
+	if(o.interval > 0.f) { total += o.interval * scoreInterval(v, o.steps, o.interval_target); }
+	if(o.fit > 0.f) { total += o.fit * scoreFit(v, o.steps, o.scale_mask); }
+
+	return total;
+}
+
+////////////
+// search //
+////////////
+
+struct Result
+{
+	float score;
+	long long seed;
+
+	// lowest score at the top of the heap, so it's the one to drop
+	bool operator<(const Result& other) const
+	{
+		return score > other.score || (score == other.score && seed < other.seed);
+	}
+};
+
+typedef std::priority_queue<Result> TopK;
+
+template <typename Sequence>
+static void searchWorker(const Options& o, std::atomic<long long>& next, TopK& best)
+{
+	const long long CHUNK = 4096;
+	float values[MAX_STEPS];
+	Sequence sequence;
+
+	while(true)
+	{
+		long long start = next.fetch_add(CHUNK);
+		if(start >= o.to) { break; }
+		long long end = std::min(start + CHUNK, o.to);
+
+		for(long long s = start; s < end; s++)
+		{
+			sequence.seed(s);
+
+			for(int i = 0; i < o.steps; i++)
+			{
+				float target = sequence.next(o.mode, o.scale, o.offset);
+				values[i] = std::min(std::max(target, 0.f), 10.f); // the module clamps its output
+			}
+
+			Result r = {score(o, values), s};
+
+			if((int) best.size() < o.top) { best.push(r); }
+			else if(r < best.top()) { best.pop(); best.push(r); }
+		}
+	}
+}
+
+/////////////////////
+// option handling //
+/////////////////////
+
+static int scaleMask(const std::string& name)
+{
+	if(name == "major") { return 0xab5; }
+	if(name == "minor") { return 0x5ad; }
+	if(name == "pentatonic") { return 0x295; }
+	if(name == "chromatic") { return 0xfff; }
+
+	// otherwise a 12 character pattern starting on C, e.g. 101011010101
+	int mask = 0;
+	for(size_t i = 0; i < name.size() && i < 12; i++) { if(name[i] == '1') { mask |= 1 << i; } }
+	return mask;
+}
+
+static void usage()
+{
+	printf("usage: seedsearch [options] criteria...\n\n");
+	printf("module settings:\n");
+	printf("  -m 0-4              mode (0 uniform, 1 inverse linear, 2 linear, 3 triangle, 4 inverse triangle)\n");
+	printf("  -s 10               scale in volts\n");
+	printf("  -o 0                offset in volts\n");
+	printf("  -n 16               steps to score after a reseed (max %d)\n", MAX_STEPS);
+	printf("  -x                  fixed-point engine\n\n");
+	printf("search:\n");
+	printf("  -r 0:16777216       seed range\n");
+	printf("  -k 32               how many seeds to keep\n");
+	printf("  -j N                threads (default all cores)\n");
+	printf("  -f seeds.txt        output file\n\n");
+	printf("criteria, each as a weight plus its own settings:\n");
+	printf("  --coverage W                     visit as much of the 0-10V range as possible\n");
+	printf("  --repetition W FRACTION          fraction of notes repeating an earlier one\n");
+	printf("  --contour W up|down|arch|valley  follow an overall shape\n");
+	printf("  --interval W VOLTS               mean step size\n");
+	printf("  --fit W major|minor|pentatonic|chromatic|101011010101  land on notes of a scale\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options o;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		int left = argc - i - 1;
+
+		if(arg == "-m" && left >= 1) { o.mode = std::min(4, std::max(0, std::atoi(argv[++i]))); }
+		else if(arg == "-s" && left >= 1) { o.scale = std::atof(argv[++i]); }
+		else if(arg == "-o" && left >= 1) { o.offset = std::atof(argv[++i]); }
+		else if(arg == "-n" && left >= 1) { o.steps = std::min(MAX_STEPS, std::max(2, std::atoi(argv[++i]))); }
+		else if(arg == "-x") { o.fixed = true; }
+		else if(arg == "-k" && left >= 1) { o.top = std::max(1, std::atoi(argv[++i])); }
+		else if(arg == "-j" && left >= 1) { o.threads = std::max(1, std::atoi(argv[++i])); }
+		else if(arg == "-f" && left >= 1) { o.out = argv[++i]; }
+		else if(arg == "-r" && left >= 1)
+		{
+			std::string range = argv[++i];
+			size_t colon = range.find(':');
+			if(colon == std::string::npos) { usage(); return 1; }
+			o.from = std::atoll(range.substr(0, colon).c_str());
+			o.to = std::atoll(range.substr(colon + 1).c_str());
+		}
+		else if(arg == "--coverage" && left >= 1) { o.coverage = std::atof(argv[++i]); }
+		else if(arg == "--repetition" && left >= 2) { o.repetition = std::atof(argv[++i]); o.repetition_target = std::atof(argv[++i]); }
+		else if(arg == "--contour" && left >= 2) { o.contour = std::atof(argv[++i]); o.contour_shape = argv[++i]; }
+		else if(arg == "--interval" && left >= 2) { o.interval = std::atof(argv[++i]); o.interval_target = std::atof(argv[++i]); }
+		else if(arg == "--fit" && left >= 2) { o.fit = std::atof(argv[++i]); o.scale_mask = scaleMask(argv[++i]); }
+		else { usage(); return arg == "-h" ? 0 : 1; }
+	}
+
+	if(o.coverage + o.repetition + o.contour + o.interval + o.fit <= 0.f)
+	{
+		fprintf(stderr, "no criteria given, see -h\n");
+		return 1;
+	}
+
+	if(o.threads < 1) { o.threads = 1; }
+	buildContour(o);
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::atomic<long long> next(o.from);
+	std::vector<TopK> best(o.threads);
+	std::vector<std::thread> workers;
+
+	for(int t = 0; t < o.threads; t++)
+	{
+		if(o.fixed) { workers.emplace_back(searchWorker<DatawaveFixedSequence>, std::cref(o), std::ref(next), std::ref(best[t])); }
+		else { workers.emplace_back(searchWorker<DatawaveSequence>, std::cref(o), std::ref(next), std::ref(best[t])); }
+	}
+
+	for(std::thread& w : workers) { w.join(); }
+
+	// merge every thread's top K, best first
+	std::vector<Result> results;
+
+	for(TopK& k : best)
+	{
+		while(!k.empty()) { results.push_back(k.top()); k.pop(); }
+	}
+
+	std::sort(results.begin(), results.end());
+	if((int) results.size() > o.top) { results.resize(o.top); }
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	FILE* f = std::fopen(o.out.c_str(), "w");
+	if(!f) { perror(o.out.c_str()); return 1; }
+
+	fprintf(f, "# datawave seeds: mode %u, scale %g, offset %g, %d steps%s\n", o.mode, o.scale, o.offset, o.steps, o.fixed ? ", fixed-point" : "");
+
+	for(const Result& r : results)
+	{
+		fprintf(f, "%lld %.4f\n", r.seed, r.score);
+	}
+
+	std::fclose(f);
+
+	printf("searched %lld seeds in %.2fs on %d threads, best score %.4f (seed %lld), wrote %s\n",
+		o.to - o.from, elapsed, o.threads, results.empty() ? 0.f : results[0].score, results.empty() ? 0LL : results[0].seed, o.out.c_str());
+
+	return 0;
+}
@@ -0,0 +1,394 @@
+////////////////////////////////////////////////////////////////////////////
+// Headless many-instance stress harness                                  //
+//                                                                        //
+// Creates N instances of each module (and mixed Syn/Chronos/Datawave     //
+// graphs), then drives them with a simulated multi-threaded engine loop  //
+// that works like Rack's: cables are stepped once per frame, the worker  //
+// threads steal modules off a shared counter, and everybody meets at a   //
+// barrier before the next frame starts.                                  //
+//                                                                        //
+// Build with `make stress`, run with `build/stress -h` for options.      //
+////////////////////////////////////////////////////////////////////////////
+
+#include "../src/plugin.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct HarnessCable
+{
+	Module* outModule;
+	int outputId;
+	Module* inModule;
+	int inputId;
+};
+
+struct Rig
+{
+	std::vector<Module*> modules;
+	std::vector<HarnessCable> cables;
+
+	// inputs that the harness drives with its own square clock
+	std::vector<Input*> clockInputs;
+
+	~Rig()
+	{
+		for(Module* m : modules) { delete m; }
+	}
+
+	Module* add(Model* model)
+	{
+		Module* m = model->createModule();
+		modules.push_back(m);
+		return m;
+	}
+
+	void connect(Module* out, int outputId, Module* in, int inputId)
+	{
+		out->outputs[outputId].channels = 1;
+		in->inputs[inputId].channels = 1;
+		cables.push_back({out, outputId, in, inputId});
+	}
+
+	void clock(Module* in, int inputId)
+	{
+		in->inputs[inputId].channels = 1;
+		clockInputs.push_back(&in->inputs[inputId]);
+	}
+};
+
+/////////////////////////////////////////////////////////////////////
+// the module structs live in their own translation units, so look //
+// ports up by the names they were configured with                 //
+/////////////////////////////////////////////////////////////////////
+
+static int findInput(Module* m, const std::string& name)
+{
+	for(size_t i = 0; i < m->inputInfos.size(); i++)
+	{
+		if(m->inputInfos[i] && m->inputInfos[i]->name == name) { return i; }
+	}
+
+	fprintf(stderr, "no input named \"%s\"\n", name.c_str());
+	exit(1);
+}
+
+static int findOutput(Module* m, const std::string& name)
+{
+	for(size_t i = 0; i < m->outputInfos.size(); i++)
+	{
+		if(m->outputInfos[i] && m->outputInfos[i]->name == name) { return i; }
+	}
+
+	fprintf(stderr, "no output named \"%s\"\n", name.c_str());
+	exit(1);
+}
+
+static int findParam(Module* m, const std::string& name)
+{
+	for(size_t i = 0; i < m->paramQuantities.size(); i++)
+	{
+		if(m->paramQuantities[i] && m->paramQuantities[i]->name == name) { return i; }
+	}
+
+	fprintf(stderr, "no param named \"%s\"\n", name.c_str());
+	exit(1);
+}
+
+///////////////
+// scenarios //
+///////////////
+
+// menu settings for every Datawave, so the engines can be timed against each other
+static bool datawaveFixed = false;
+static bool datawaveAudio = false;
+
+static Module* addDatawave(Rig& rig)
+{
+	Module* dw = rig.add(modelDatawave);
+	dw->params[findParam(dw, "fixed-point engine")].setValue(datawaveFixed);
+	dw->params[findParam(dw, "audio rate")].setValue(datawaveAudio);
+	return dw;
+}
+
+// N Datawaves, each clocked by the harness
+static void buildDatawave(Rig& rig, int n)
+{
+	for(int i = 0; i < n; i++)
+	{
+		Module* dw = addDatawave(rig);
+		if(!datawaveAudio) { rig.clock(dw, findInput(dw, "clock")); } // at audio rate the jack is V/oct, so leave it at C4
+		dw->outputs[findOutput(dw, "CV")].channels = 1;
+	}
+}
+
+// N free running Chronos with all three sub clocks patched
+static void buildChronos(Rig& rig, int n)
+{
+	for(int i = 0; i < n; i++)
+	{
+		Module* ch = rig.add(modelChronos);
+		for(int j = 1; j <= 3; j++) { ch->outputs[findOutput(ch, "sub clock " + std::to_string(j))].channels = 1; }
+	}
+}
+
+// N Syns all fighting over the globals, plus N Chronos following them
+static void buildSyn(Rig& rig, int n)
+{
+	for(int i = 0; i < n; i++) { rig.add(modelSyn); }
+	buildChronos(rig, n);
+}
+
+// one Syn, then groups of one Chronos clocking three Datawaves, where each
+// Datawave's CV modulates the scale of the next one in the group
+static void buildMixed(Rig& rig, int n)
+{
+	rig.add(modelSyn);
+
+	for(int i = 0; i < n; i += 4)
+	{
+		Module* ch = rig.add(modelChronos);
+		Module* prev = NULL;
+
+		for(int j = 1; j <= 3; j++)
+		{
+			Module* dw = addDatawave(rig);
+			if(!datawaveAudio) { rig.connect(ch, findOutput(ch, "sub clock " + std::to_string(j)), dw, findInput(dw, "clock")); }
+			if(prev) { rig.connect(prev, findOutput(prev, "CV"), dw, findInput(dw, "scale")); }
+			prev = dw;
+		}
+
+		prev->outputs[findOutput(prev, "CV")].channels = 1;
+	}
+}
+
+struct Scenario
+{
+	const char* name;
+	void (*build)(Rig&, int);
+};
+
+static const Scenario scenarios[] =
+{
+	{"datawave", buildDatawave},
+	{"chronos", buildChronos},
+	{"syn", buildSyn},
+	{"mixed", buildMixed},
+};
+
+/////////////////////////////////////////////////////////////
+// simulated engine, one frame at a time like Rack's own   //
+/////////////////////////////////////////////////////////////
+
+struct SpinBarrier
+{
+	std::atomic<int> count{0};
+	std::atomic<int> generation{0};
+	int total = 1;
+
+	void wait()
+	{
+		int gen = generation.load(std::memory_order_acquire);
+
+		if(count.fetch_add(1, std::memory_order_acq_rel) + 1 == total)
+		{
+			count.store(0, std::memory_order_relaxed);
+			generation.fetch_add(1, std::memory_order_release);
+			return;
+		}
+
+		// spin a while for the short waits, then give the core up so oversubscribed runs
+		// measure the modules rather than threads waiting to be scheduled, as Rack's own barrier does
+		for(int spins = 0; generation.load(std::memory_order_acquire) == gen; spins++)
+		{
+			if(spins >= 1000) { std::this_thread::yield(); }
+		}
+	}
+};
+
+struct HarnessEngine
+{
+	Rig* rig;
+	int threads = 1;
+	float sampleRate = 48000.f;
+
+	SpinBarrier startBarrier;
+	SpinBarrier endBarrier;
+	alignas(64) std::atomic<size_t> next{0};
+	alignas(64) std::atomic<bool> running{true};
+	Module::ProcessArgs args;
+
+	void stepModules()
+	{
+		const size_t len = rig->modules.size();
+
+		while(true)
+		{
+			size_t i = next.fetch_add(1, std::memory_order_relaxed);
+			if(i >= len) { break; }
+			rig->modules[i]->process(args);
+		}
+	}
+
+	void worker()
+	{
+		while(true)
+		{
+			startBarrier.wait();
+			if(!running.load(std::memory_order_relaxed)) { return; }
+			stepModules();
+			endBarrier.wait();
+		}
+	}
+
+	// returns wall clock seconds taken to process the given number of frames
+	double run(int64_t frames)
+	{
+		startBarrier.total = threads;
+		endBarrier.total = threads;
+		running = true;
+
+		std::vector<std::thread> workers;
+		for(int t = 1; t < threads; t++) { workers.emplace_back(&HarnessEngine::worker, this); }
+
+		args.sampleRate = sampleRate;
+		args.sampleTime = 1.f / sampleRate;
+
+		const int64_t clockPeriod = sampleRate / 8.f; // harness clock at 8Hz
+
+		auto start = std::chrono::steady_clock::now();
+
+		for(int64_t frame = 0; frame < frames; frame++)
+		{
+			// step cables and the harness clock on the main thread, as Rack does
+			for(const HarnessCable& c : rig->cables)
+			{
+				c.inModule->inputs[c.inputId].setVoltage(c.outModule->outputs[c.outputId].getVoltage());
+			}
+
+			float clockVoltage = (frame % clockPeriod) < (clockPeriod / 2) ? 10.f : 0.f;
+			for(Input* in : rig->clockInputs) { in->setVoltage(clockVoltage); }
+
+			args.frame = frame;
+			next.store(0, std::memory_order_relaxed);
+
+			startBarrier.wait();
+			stepModules();
+			endBarrier.wait();
+		}
+
+		auto end = std::chrono::steady_clock::now();
+
+		running = false;
+		startBarrier.wait();
+		for(std::thread& w : workers) { w.join(); }
+
+		return std::chrono::duration<double>(end - start).count();
+	}
+};
+
+/////////////////////
+// option handling //
+/////////////////////
+
+static std::vector<int> parseList(const char* arg)
+{
+	std::vector<int> list;
+	std::string s = arg;
+	size_t pos = 0;
+
+	while(pos <= s.size())
+	{
+		size_t comma = s.find(',', pos);
+		if(comma == std::string::npos) { comma = s.size(); }
+		int v = std::atoi(s.substr(pos, comma - pos).c_str());
+		if(v > 0) { list.push_back(v); }
+		pos = comma + 1;
+	}
+
+	return list;
+}
+
+static void usage()
+{
+	printf("usage: stress [options]\n");
+	printf("  -n 50,100,200,400   instance counts per scenario\n");
+	printf("  -t 1,2,4,8,16       worker thread counts\n");
+	printf("  -s 2                seconds of audio to simulate per run\n");
+	printf("  -r 48000            sample rate\n");
+	printf("  -o datawave,mixed   only run the named scenarios\n");
+	printf("  -x                  Datawaves use the fixed-point engine\n");
+	printf("  -a                  Datawaves run at audio rate\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> counts = {50, 100, 200, 400};
+	std::vector<int> threadCounts = {1, 2, 4, 8, 16};
+	float seconds = 2.f;
+	float sampleRate = 48000.f;
+	std::string only;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if(arg == "-n" && hasValue) { counts = parseList(argv[++i]); }
+		else if(arg == "-t" && hasValue) { threadCounts = parseList(argv[++i]); }
+		else if(arg == "-s" && hasValue) { seconds = std::atof(argv[++i]); }
+		else if(arg == "-r" && hasValue) { sampleRate = std::atof(argv[++i]); }
+		else if(arg == "-o" && hasValue) { only = argv[++i]; }
+		else if(arg == "-x") { datawaveFixed = true; }
+		else if(arg == "-a") { datawaveAudio = true; }
+		else { usage(); return arg == "-h" ? 0 : 1; }
+	}
+
+	const int64_t frames = seconds * sampleRate;
+
+	printf("hardware threads: %u, %lld frames per run at %g Hz\n\n", std::thread::hardware_concurrency(), (long long) frames, sampleRate);
+	printf("%-10s %9s %8s %10s %14s %9s %8s %11s\n", "scenario", "instances", "threads", "seconds", "module-smp/s", "realtime", "speedup", "efficiency");
+
+	for(const Scenario& scenario : scenarios)
+	{
+		if(!only.empty() && ("," + only + ",").find(std::string(",") + scenario.name + ",") == std::string::npos) { continue; }
+
+		for(int n : counts)
+		{
+			double baseline = 0.0;
+
+			for(int threads : threadCounts)
+			{
+				// fresh modules for every run so one run can't warm the next one's caches
+				Rig rig;
+				scenario.build(rig, n);
+
+				// globals are shared between runs, put them back to the power on state
+				_SYNC = false;
+				_BPM = 120;
+				_RUN = true;
+
+				HarnessEngine engine;
+				engine.rig = &rig;
+				engine.threads = threads;
+				engine.sampleRate = sampleRate;
+
+				double elapsed = engine.run(frames);
+				if(baseline == 0.0) { baseline = elapsed; }
+
+				double throughput = (double) frames * rig.modules.size() / elapsed;
+				double realtime = (frames / sampleRate) / elapsed;
+				double speedup = baseline / elapsed;
+
+				printf("%-10s %9zu %8d %10.3f %14.3e %8.1fx %7.2fx %10.0f%%\n", scenario.name, rig.modules.size(), threads, elapsed, throughput, realtime, speedup, 100.0 * speedup / threads);
+			}
+
+			printf("\n");
+		}
+	}
+
+	return 0;
+}